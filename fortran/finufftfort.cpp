@@ -25,8 +25,11 @@
 #ifdef SINGLE
 #define FINUFFT_MAKEPLAN_ finufftf_makeplan_
 #define FINUFFT_SETPTS_ finufftf_setpts_
+#define FINUFFT_SORTPERM_ finufftf_sortperm_
 #define FINUFFT_EXECUTE_ finufftf_execute_
 #define FINUFFT_DESTROY_ finufftf_destroy_
+#define FINUFFT_CACHE_STATS_ finufftf_cache_stats_
+#define FINUFFT_CACHE_CLEAR_ finufftf_cache_clear_
 #define FINUFFT_DEFAULT_OPTS_ finufftf_default_opts_
 #define FINUFFT1D1_ finufftf1d1_
 #define FINUFFT1D1MANY_ finufftf1d1many_
@@ -49,8 +52,11 @@
 #else
 #define FINUFFT_MAKEPLAN_ finufft_makeplan_
 #define FINUFFT_SETPTS_ finufft_setpts_
+#define FINUFFT_SORTPERM_ finufft_sortperm_
 #define FINUFFT_EXECUTE_ finufft_execute_
 #define FINUFFT_DESTROY_ finufft_destroy_
+#define FINUFFT_CACHE_STATS_ finufft_cache_stats_
+#define FINUFFT_CACHE_CLEAR_ finufft_cache_clear_
 #define FINUFFT_DEFAULT_OPTS_ finufft_default_opts_
 #define FINUFFT1D1_ finufft1d1_
 #define FINUFFT1D1MANY_ finufft1d1many_
@@ -100,6 +106,14 @@ void FINUFFT_SETPTS_(FINUFFT_PLAN *plan, BIGINT *M, FLT *xj, FLT *yj, FLT *zj, B
   *ier = FINUFFT_SETPTS(*plan, *M, xj, yj, zj, nk_safe, s, t, u);
 }
 
+void FINUFFT_SORTPERM_(FINUFFT_PLAN *plan, BIGINT *perm, int *ier)
+{
+  if (!plan)
+    fprintf(stderr,"%s fortran: finufft_plan unallocated!",__func__);
+  else
+    *ier = FINUFFT_SORTPERM(*plan, perm);
+}
+
 void FINUFFT_EXECUTE_(FINUFFT_PLAN *plan, CPX *weights, CPX *result, int *ier)
 {
   if (!plan)
@@ -116,6 +130,16 @@ void FINUFFT_DESTROY_(FINUFFT_PLAN *plan, int *ier)
     *ier = FINUFFT_DESTROY(*plan);
 }
 
+void FINUFFT_CACHE_STATS_(BIGINT *stats)
+{
+  FINUFFT_CACHE_STATS(stats);
+}
+
+void FINUFFT_CACHE_CLEAR_(int *ninuse)
+{
+  *ninuse = FINUFFT_CACHE_CLEAR();
+}
+
   
 // ------------ use FINUFFT to set the default options ---------------------
 // (Note the nufft_opts is created in f90-style derived types, not here)
@@ -29,6 +29,12 @@
 // Increase this if you need >1TB RAM... (used only in common.cpp)
 #define MAX_NF    (BIGINT)1e11
 
+// Max number of unused entries of each kind (FFTW plans, kernel Fourier
+// series) kept by the opts.plan_cache cache (used only in finufft.cpp)
+#ifndef PLAN_CACHE_MAX
+#define PLAN_CACHE_MAX 16
+#endif
+
 
 
 // ---------- Global error/warning output codes for the library ---------------
@@ -50,6 +56,7 @@
 #define ERR_ALLOC                11
 #define ERR_DIM_NOTVALID         12
 #define ERR_SPREAD_THREAD_NOTVALID 13
+#define ERR_SPREAD_METHOD_NOTVALID 14
 
 
 
@@ -103,12 +110,16 @@
   #define MY_OMP_GET_MAX_THREADS() omp_get_max_threads()
   #define MY_OMP_GET_THREAD_NUM() omp_get_thread_num()
   #define MY_OMP_SET_NUM_THREADS(x) omp_set_num_threads(x)
+  #define MY_OMP_GET_MAX_ACTIVE_LEVELS() omp_get_max_active_levels()
+  #define MY_OMP_SET_MAX_ACTIVE_LEVELS(x) omp_set_max_active_levels(x)
 #else
   // non-omp safe dummy versions of omp utils, and dummy fftw threads calls...
   #define MY_OMP_GET_NUM_THREADS() 1
   #define MY_OMP_GET_MAX_THREADS() 1
   #define MY_OMP_GET_THREAD_NUM() 0
   #define MY_OMP_SET_NUM_THREADS(x)
+  #define MY_OMP_GET_MAX_ACTIVE_LEVELS() 1
+  #define MY_OMP_SET_MAX_ACTIVE_LEVELS(x)
   #undef FFTW_INIT
   #define FFTW_INIT()
   #undef FFTW_PLAN_TH
@@ -10,6 +10,7 @@
 #ifdef SINGLE
   typedef fftwf_complex FFTW_CPX;           //  single-prec has fftwf_*
   typedef fftwf_plan FFTW_PLAN;
+  typedef fftwf_iodim FFTW_IODIM;
   #define FFTW_INIT fftwf_init_threads
   #define FFTW_PLAN_TH fftwf_plan_with_nthreads
   #define FFTW_ALLOC_RE fftwf_alloc_real
@@ -18,7 +19,9 @@
   #define FFTW_PLAN_2D fftwf_plan_dft_2d
   #define FFTW_PLAN_3D fftwf_plan_dft_3d
   #define FFTW_PLAN_MANY_DFT fftwf_plan_many_dft
+  #define FFTW_PLAN_GURU_DFT fftwf_plan_guru_dft
   #define FFTW_EX fftwf_execute
+  #define FFTW_EX_DFT fftwf_execute_dft
   #define FFTW_DE fftwf_destroy_plan
   #define FFTW_FR fftwf_free
   #define FFTW_FORGET_WISDOM fftwf_forget_wisdom
@@ -32,6 +35,7 @@
 #else
   typedef fftw_complex FFTW_CPX;           // double-prec has fftw_*
   typedef fftw_plan FFTW_PLAN;
+  typedef fftw_iodim FFTW_IODIM;
   #define FFTW_INIT fftw_init_threads
   #define FFTW_PLAN_TH fftw_plan_with_nthreads
   #define FFTW_ALLOC_RE fftw_alloc_real
@@ -40,7 +44,9 @@
   #define FFTW_PLAN_2D fftw_plan_dft_2d
   #define FFTW_PLAN_3D fftw_plan_dft_3d
   #define FFTW_PLAN_MANY_DFT fftw_plan_many_dft
+  #define FFTW_PLAN_GURU_DFT fftw_plan_guru_dft
   #define FFTW_EX fftw_execute
+  #define FFTW_EX_DFT fftw_execute_dft
   #define FFTW_DE fftw_destroy_plan
   #define FFTW_FR fftw_free
   #define FFTW_FORGET_WISDOM fftw_forget_wisdom
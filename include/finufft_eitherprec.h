@@ -20,8 +20,11 @@
 #undef FINUFFT_DEFAULT_OPTS
 #undef FINUFFT_MAKEPLAN
 #undef FINUFFT_SETPTS
+#undef FINUFFT_SORTPERM
 #undef FINUFFT_EXECUTE
 #undef FINUFFT_DESTROY
+#undef FINUFFT_CACHE_STATS
+#undef FINUFFT_CACHE_CLEAR
 #undef FINUFFT1D1
 #undef FINUFFT1D1MANY
 #undef FINUFFT1D2
@@ -45,8 +48,11 @@
 #define FINUFFT_DEFAULT_OPTS finufftf_default_opts
 #define FINUFFT_MAKEPLAN finufftf_makeplan
 #define FINUFFT_SETPTS finufftf_setpts
+#define FINUFFT_SORTPERM finufftf_sortperm
 #define FINUFFT_EXECUTE finufftf_execute
 #define FINUFFT_DESTROY finufftf_destroy
+#define FINUFFT_CACHE_STATS finufftf_cache_stats
+#define FINUFFT_CACHE_CLEAR finufftf_cache_clear
 #define FINUFFT1D1 finufftf1d1
 #define FINUFFT1D1MANY finufftf1d1many
 #define FINUFFT1D2 finufftf1d2
@@ -69,8 +75,11 @@
 #define FINUFFT_DEFAULT_OPTS finufft_default_opts
 #define FINUFFT_MAKEPLAN finufft_makeplan
 #define FINUFFT_SETPTS finufft_setpts
+#define FINUFFT_SORTPERM finufft_sortperm
 #define FINUFFT_EXECUTE finufft_execute
 #define FINUFFT_DESTROY finufft_destroy
+#define FINUFFT_CACHE_STATS finufft_cache_stats
+#define FINUFFT_CACHE_CLEAR finufft_cache_clear
 #define FINUFFT1D1 finufft1d1
 #define FINUFFT1D1MANY finufft1d1many
 #define FINUFFT1D2 finufft1d2
@@ -104,8 +113,11 @@ extern "C"
 void FINUFFT_DEFAULT_OPTS(nufft_opts *o);
 int FINUFFT_MAKEPLAN(int type, int dim, BIGINT* n_modes, int iflag, int n_transf, FLT tol, FINUFFT_PLAN* plan, nufft_opts* o);
 int FINUFFT_SETPTS(FINUFFT_PLAN plan , BIGINT M, FLT *xj, FLT *yj, FLT *zj, BIGINT N, FLT *s, FLT *t, FLT *u); 
+int FINUFFT_SORTPERM(FINUFFT_PLAN plan, BIGINT* perm);
 int FINUFFT_EXECUTE(FINUFFT_PLAN plan, CPX* weights, CPX* result);
 int FINUFFT_DESTROY(FINUFFT_PLAN plan);
+void FINUFFT_CACHE_STATS(BIGINT* stats);
+int FINUFFT_CACHE_CLEAR(void);
 
 
 // ----------------- the 18 simple interfaces -------------------------------
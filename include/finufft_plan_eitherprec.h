@@ -23,14 +23,20 @@
 #undef TYPE3PARAMS
 #undef FINUFFT_PLAN
 #undef FINUFFT_PLAN_S
+#undef SPREAD_PLAN
+#undef KER_CACHE
 #ifdef SINGLE
 #define FINUFFT_PLAN_S finufftf_plan_s
 #define TYPE3PARAMS type3Paramsf
 #define FINUFFT_PLAN finufftf_plan
+#define SPREAD_PLAN spread_planf
+#define KER_CACHE ker_cachef
 #else
 #define FINUFFT_PLAN_S finufft_plan_s
 #define TYPE3PARAMS type3Params
 #define FINUFFT_PLAN finufft_plan
+#define SPREAD_PLAN spread_plan
+#define KER_CACHE ker_cache
 #endif
 
 // the plan handle that we pass around is just a pointer to the struct that
@@ -55,6 +61,7 @@ typedef struct FINUFFT_PLAN_S {  // the main plan struct; note C-compatible stru
   FLT tol;         // relative user tolerance
   int batchSize;   // # strength vectors to group together for FFTW, etc
   int nbatch;      // how many batches done to cover all ntrans vectors
+  int remBatchSize; // size of the short last batch (ntrans % batchSize), or 0
   
   BIGINT ms;       // number of modes in x (1) dir (historical CMCL name) = N1
   BIGINT mt;       // number of modes in y (2) direction = N2
@@ -65,18 +72,31 @@ typedef struct FINUFFT_PLAN_S {  // the main plan struct; note C-compatible stru
   BIGINT nf2;      // " y
   BIGINT nf3;      // " z
   BIGINT nf;       // total # fine grid points (product of the above three)
+  BIGINT nfw;      // # complex entries per fine grid array in fwBatch: nf, or
+                   // more if they carry spopts.ghost ghost pts per side
+  BIGINT fwoff;    // index of fine grid pt (0,0,0) in each array (0 w/o ghosts)
   
   int fftSign;     // sign in exponential for NUFFT defn, guaranteed to be +-1
 
-  FLT* phiHat1;    // FT of kernel in t1,2, on x-axis mode grid
-  FLT* phiHat2;    // " y-axis.
-  FLT* phiHat3;    // " z-axis.
+  FLT* phiHatInv1; // 1/(FT of kernel) in t1,2, on x-axis mode grid
+  FLT* phiHatInv2; // " y-axis.
+  FLT* phiHatInv3; // " z-axis.
   
   FFTW_CPX* fwBatch;    // (batches of) fine grid(s) for FFTW to plan & act on.
                         // Usually the largest working array
+  FFTW_CPX* fwBatch2;   // opts.batch_pipeline only (else NULL): 2nd buffer of
+                        // batchSize fine grids, in the fwBatch alloc, used
+                        // by alternate batches
+  FFTW_CPX* fwPadBatch; // t2 with opts.zeropad_once only (else NULL): the FFT
+                        // input grids (nf each, no ghosts), zeroed once at plan
+                        // so deconvolve only writes the modes; FFT to fwBatch
   
-  BIGINT *sortIndices;  // precomputed NU pt permutation, speeds spread/interp
+  void *sortIndices;    // precomputed NU pt permutation, speeds spread/interp
+  bool sortIdx32;       // whether sortIndices is uint32_t (nj fits), else BIGINT
   bool didSort;         // whether binsorting used (false: identity perm used)
+  struct SPREAD_PLAN *spreadPlan;  // t1,3 spreader subproblems & thread arena
+                                   // (opaque; see spreadinterp.h)
+  struct KER_CACHE *kerCache;      // cached NU pt kernel values, or NULL
 
   FLT *X, *Y, *Z;  // for t1,2: ptr to user-supplied NU pts (no new allocs).
                    // for t3: allocated as "primed" (scaled) src pts x'_j, etc
@@ -91,7 +111,16 @@ typedef struct FINUFFT_PLAN_S {  // the main plan struct; note C-compatible stru
   FINUFFT_PLAN innerT2plan;   // ptr used for type 2 in step 2 of type 3
   
   // other internal structs; each is C-compatible of course
-  FFTW_PLAN fftwPlan;
+  FFTW_PLAN fftwPlan;       // full FFT of the batch (NULL if pruned)
+  FFTW_PLAN fftwPasses[7];  // opts.fftw_prune: 1D passes (up to 1+2+4 in 3D),
+  int nfftwPasses;          // in exec order; 0 if fftwPlan is used instead
+  BIGINT fftwPassOff[7];    // offset in fwBatch of each pass's first line
+  FFTW_PLAN fftwPlanRem;    // if remBatchSize>0, same two for the short last
+  FFTW_PLAN fftwRemPasses[7];  // batch, so no FFT of unused grids
+  int nthrPipeFFT;          // opts.batch_pipeline: # threads FFTW is planned
+                            // for, also doing deconvolve; the rest spread or
+                            // interp. 0 if batches not pipelined
+  int nthrPipeTuned;        // split re-tuned by execute, for the next setpts
   nufft_opts opts;     // this and spopts could be made ptrs
   spread_opts spopts;
   
@@ -26,10 +26,44 @@ typedef struct nufft_opts{    // defaults see finufft.cpp:finufft_default_opts()
   int spread_kerpad;      // (exp(sqrt()) only): 0 don't pad kernel to 4n, 1 do
   double upsampfac;       // upsampling ratio sigma: 2.0 std, 1.25 small FFT, 0.0 auto
   int spread_thread;      // (vectorized ntr>1 only): 0 auto, 1 seq multithreaded,
-                          //                          2 parallel single-thread spread
+                          //                          2 parallel single-thread spread,
+                          //                          3 fused multithreaded (ker evals shared)
   int maxbatchsize;       // (vectorized ntr>1 only): max transform batch, 0 auto
   int spread_nthr_atomic; // if >=0, threads above which spreader OMP critical goes atomic
   int spread_max_sp_size; // if >0, overrides spreader (dir=1) max subproblem size
+  int spread_method;      // spreader (dir=1): 0 auto, 1 subprobs added to grid w/
+                          // OMP critical/atomic, 2 owner-computes grid tiles,
+                          // 3 direct to grid (single-threaded)
+  int spread_kercache;    // 0 eval kernels each exec, 1 precompute at setpts
+  int spread_kercache_mb; // (kercache=1 only): max RAM (MB) for cache, else not used
+  int spread_copypts;     // (type 1,2 only): 0 keep ptrs to user's NU pts,
+                          // 1 keep a folded copy in sorted order in the plan
+  int spread_sortedio;    // (type 1,2 only): 0 c in user's NU pt order,
+                          // 1 c in plan's sorted order (see finufft_sortperm)
+  int spread_ghost;       // (type 1,2 only): 0 plain fine grid, 1 pad it with
+                          // ghost pts so spread/interp need no wrapping
+  int spread_balance;     // spreader (dir=1): 0 subprobs of equal # NU pts,
+                          // 1 of whole sort bins, capped in subgrid size
+  int zeropad_once;       // (type 2 only): 0 zero-pad fine grids each exec, 1
+                          // zero them once at plan (out-of-place FFT, 2x RAM)
+  int numa;               // fine grid NUMA placement: 0 first touch, 1 pages
+                          // interleaved over nodes, 2 first touch in per-thread
+                          // slabs, spread/interp slab-local (sorted pts only)
+  int hugepages;          // 0 usual pages, 1 ask for transparent huge pages
+                          // for the big plan arrays (Linux madvise)
+  int spread_interp_method; // interp (dir=2, sorted pts): 0 from the fine grid,
+                          // 1 from L2-sized subgrid copies (dense NU pts)
+  int spread_binsize_x;   // NU pt sort bin sizes (in fine grid pts) per dim,
+  int spread_binsize_y;   // 0 auto (from kernel width, grid shape and cache
+  int spread_binsize_z;   // sizes), >0 overrides
+  int spread_binorder;    // order sort bins are read out in: 0 Cartesian,
+                          // 1 Morton, 2 Hilbert curve (compacter subgrids)
+  int fftw_prune;         // (type 1,2, 2D/3D): 0 full FFT, 1 pruned 1D passes
+                          // skipping zero (t2) or unused (t1) grid lines
+  int batch_pipeline;     // (t1,2 with >1 batch): 0 batches in turn, 1 spread/
+                          // interp one batch while FFTing another (2x fwBatch)
+  int plan_cache;         // (t1,2, t3's inner t2): 0 plan owns its FFTW plans and
+                          // kernel series, 1 share them via a process-wide cache
   // sphinx tag (don't remove): @opts_end
 } nufft_opts;
 
@@ -0,0 +1,134 @@
+// Minimal portable SIMD layer for the spreader/interpolator inner loops.
+// Built on GCC/clang generic vector extensions, so the same source compiles to
+// SSE, AVX2 or AVX-512 instructions according to the target of the function it
+// is inlined into (see SIMD_TARGET_* below and set_spread_kernels in
+// spreadinterp.cpp, which picks the widest at runtime via CPUID).
+// Array lengths N are compile-time (eg 2*ns, ns the kernel width): loops run
+// full vectors of W elements, then the remainder with vectors of W/2, W/4,...
+// so that no masked ops, padding, or reads/writes past element N-1 are needed.
+// Only C++ (templates), and purely internal to the library.
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_VECEXT                // have generic vector extensions
+#define SIMD_INLINE inline __attribute__((always_inline))
+#else
+#define SIMD_INLINE inline
+#endif
+
+// vector register size (bytes) the library as a whole is compiled for...
+#if defined(__AVX512F__)
+#define SIMD_BASE_BYTES 64
+#elif defined(__AVX__)
+#define SIMD_BASE_BYTES 32
+#else
+#define SIMD_BASE_BYTES 16
+#endif
+
+// runtime dispatch to wider ISAs than the compile flags give: x86 GCC/clang.
+// Kernels are instanced inside functions carrying these target attributes,
+// only for ISAs wider than SIMD_BASE_BYTES (else the generic ones suffice).
+#if defined(SIMD_VECEXT) && (defined(__x86_64__) || defined(__i386__)) && !defined(__INTEL_COMPILER)
+#define SIMD_DISPATCH
+#if SIMD_BASE_BYTES<32
+#define SIMD_HAVE_AVX2
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#if SIMD_BASE_BYTES<64
+#define SIMD_HAVE_AVX512
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+// ISA levels as reported by simd_level()
+#define SIMD_GENERIC 0
+#define SIMD_AVX2 1
+#define SIMD_AVX512 2
+
+static inline int simd_level()
+// best ISA level this CPU supports that we have kernels for (CPUID), capped
+// by the environment variable FINUFFT_SIMD_MAX (a SIMD_* level) if set, so
+// that the generic or AVX2 kernels can be tested on an AVX-512 CPU
+{
+  int level = SIMD_GENERIC;
+#ifdef SIMD_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    level = SIMD_AVX512;
+  else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    level = SIMD_AVX2;
+#endif
+  const char *cap = getenv("FINUFFT_SIMD_MAX");
+  if (cap && atoi(cap) < level)
+    level = (atoi(cap) > SIMD_GENERIC) ? atoi(cap) : SIMD_GENERIC;
+  return level;
+}
+
+#define SIMD_LINE_BYTES 64   // cache line size assumed by simd_prefetch_range
+
+static SIMD_INLINE void simd_prefetch_range(const void *p, size_t nbytes)
+// hint to fetch the cache lines holding bytes [p,p+nbytes) for reading; a
+// no-op without GCC/clang builtins
+{
+#ifdef SIMD_VECEXT
+  const char *a = (const char*)((size_t)p & ~(size_t)(SIMD_LINE_BYTES-1));
+  for (; a < (const char*)p + nbytes; a += SIMD_LINE_BYTES)
+    __builtin_prefetch(a, 0, 3);
+#endif
+}
+
+// Vector-length-generic ops on arrays of N elements of type T, using vectors
+// of W elements then narrower ones for the tail. Only pointers cross function
+// boundaries (never vector types), so there are no ABI issues, and everything
+// is force-inlined into the target-specific caller.
+template<class T, int N, int W>
+struct simd_ops {
+  static const int NV = (N/W)*W;     // # elements done with full vectors
+#ifdef SIMD_VECEXT
+  typedef T vec __attribute__((vector_size(W*sizeof(T))));
+
+  static SIMD_INLINE void axpy(T *y, T a, const T *x)
+  // y[0..N) += a*x[0..N). memcpy is the portable unaligned vector load/store
+  {
+    for (int i=0; i<NV; i+=W) {
+      vec xv, yv;
+      memcpy(&xv,x+i,sizeof(vec));
+      memcpy(&yv,y+i,sizeof(vec));
+      yv += a*xv;
+      memcpy(y+i,&yv,sizeof(vec));
+    }
+    simd_ops<T,N-NV,W/2>::axpy(y+NV, a, x+NV);
+  }
+#else
+  static SIMD_INLINE void axpy(T *y, T a, const T *x)
+  {
+    for (int i=0; i<N; ++i)
+      y[i] += a*x[i];
+  }
+#endif
+};
+
+// end of the tail recursion: scalar, or nothing left...
+template<class T, int N>
+struct simd_ops<T,N,1> {
+  static SIMD_INLINE void axpy(T *y, T a, const T *x)
+  {
+    for (int i=0; i<N; ++i)
+      y[i] += a*x[i];
+  }
+};
+template<class T, int W>
+struct simd_ops<T,0,W> {
+  static SIMD_INLINE void axpy(T *, T, const T *) {}
+};
+template<class T>
+struct simd_ops<T,0,1> {
+  static SIMD_INLINE void axpy(T *, T, const T *) {}
+};
+
+#endif  // SIMD_H
@@ -11,6 +11,15 @@ typedef struct spread_opts {  // see spreadinterp:setup_spreader for defaults.
   int nspread;            // w, the kernel width in grid pts
   int spread_direction;   // 1 means spread NU->U, 2 means interpolate U->NU
   int pirange;            // 0: NU periodic domain is [0,N), 1: domain [-pi,pi)
+  int sorted_pts;         // 0: j'th sorted NU pt is kx[sort_indices[j]], etc;
+                          // 1: it is kx[j], already folded to [0,N) (see
+                          // spreadinterp:fold_sorted_pts); pirange is ignored
+  int sorted_io;          // 0: j'th sorted NU pt's strength (or output) is at
+                          // data_nonuniform[2*sort_indices[j]]; 1: it is at [2*j]
+  int ghost;              // g>0: data_uniform carries g ghost pts per side in
+                          // each dim (see spreadinterp.h:ghost_dims), so no
+                          // wrapping; spreading leaves them to be folded in
+                          // and interp needs them filled (wrap_ghosts). 0: none
   int chkbnds;            // 0: don't check NU pts in 3-period range; 1: do
   int sort;               // 0: don't sort NU pts, 1: do, 2: heuristic choice
   int kerevalmeth;        // 0: direct exp(sqrt()), or 1: Horner ppval, fastest
@@ -23,11 +32,51 @@ typedef struct spread_opts {  // see spreadinterp:setup_spreader for defaults.
                           // if changed from 0!). See spreadinterp.h
   int debug;              // 0: silent, 1: small text output, 2: verbose
   int atomic_threshold;   // num threads before switching spreadSorted to using atomic ops
+  int method;             // dir=1 only. 0: auto, 1: subprobs added to grid under
+                          // OMP critical or atomic, 2: owner-computes tiles,
+                          // 3: direct to grid with wrapping (single-thread)
+  int balance;            // dir=1 subprobs: 0 equal # NU pts, 1 runs of whole
+                          // bins capped by # pts & subgrid volume, costliest
+                          // first (see spreadinterp:setup_spread_plan)
+  int numa;               // 2 (and sorted, >1 thread): each thread spreads or
+                          // interps the NU pts in its own slab of the grid
+                          // (spreadinterp:numa_slabs), not load-balanced;
+                          // else: usual dynamic scheduling
+  int prefetch;           // dir=2: prefetch the grid stencil of the NU pt this
+                          // many ahead in each chunk (0: none, <0: auto)
+  int bin_size_x;         // sizes (in grid pts) of the boxes NU pts are sorted
+  int bin_size_y;         // into, if >0, else automatic (see
+  int bin_size_z;         // spreadinterp:get_bin_sizes)
+  int bin_order;          // order the sorted bins are read out in: 0 Cartesian
+                          // (x fastest, z slowest), 1 Morton, 2 Hilbert curve
+                          // (see spreadinterp:bin_offsets); tiles (method
+                          // 2) and numa slabs need 0
+  int interp_method;      // dir=2 (and sorted): 0 read the grid directly, 1
+                          // first copy each subprob's subgrid to a per-thread
+                          // L2-sized buffer (see spreadinterp:interpSorted)
   double upsampfac;       // sigma, upsampling factor
   // ES kernel specific consts used in fast eval, depend on precision FLT...
   FLT ES_beta;
   FLT ES_halfwidth;
   FLT ES_c;
+  // routines specialized to nspread, for dims 1,2,3 (internal, set by
+  // setup_spreader; see spreadinterp.cpp:set_spread_kernels). If kv is not
+  // NULL, i0 and kv are the NU pts' cached grid start indices and kernel
+  // values (see spreadinterp.h:KER_CACHE), used instead of the coords...
+  void (*spread_subprob[3])(BIGINT *offset, BIGINT *size, FLT *du, BIGINT M,
+                            FLT *kx, FLT *ky, FLT *kz, FLT *dd, int nvec,
+                            BIGINT *i0, FLT *kv,
+                            const struct spread_opts *opts);
+  void (*interp_chunk[3])(FLT *out, int n, FLT *x, FLT *y, FLT *z, FLT *du,
+                          BIGINT N1, BIGINT N2, BIGINT N3, int nvec,
+                          BIGINT *i0, FLT *kv,
+                          const struct spread_opts *opts);
+  void (*spread_chunk[3])(FLT *du, int n, FLT *x, FLT *y, FLT *z, FLT *in,
+                          BIGINT N1, BIGINT N2, BIGINT N3, int nvec,
+                          BIGINT *i0, FLT *kv,
+                          const struct spread_opts *opts);
+  void (*ker_point)(BIGINT *i0, FLT *ker, int ndims, FLT *x,
+                    const struct spread_opts *opts);
 } spread_opts;
 
 #endif   // SPREAD_OPTS_H
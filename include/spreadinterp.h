@@ -19,27 +19,141 @@
     NUMERICAL OUTPUT MAY BE INCORRECT UNLESS spread_opts.flags=0 !
 */
 #define TF_OMIT_WRITE_TO_GRID        1 // don't add subgrids to out grid (dir=1)
+                                       // or copy them from it (dir=2)
 #define TF_OMIT_EVALUATE_KERNEL      2 // don't evaluate the kernel at all
 #define TF_OMIT_EVALUATE_EXPONENTIAL 4 // omit exp() in kernel (kereval=0 only)
 #define TF_OMIT_SPREADING            8 // don't interp/spread (dir=1: to subgrids)
 
+// Precomputed t1 (dir=1) spreading layout for a fixed set of sorted NU pts,
+// plus a per-worker arena holding each subproblem's NU pt copies and subgrid.
+// Built once by setup_spread_plan (eg in finufft_setpts), so that spreadSorted
+// does no heap allocation. Name is per-precision since both get compiled.
+// If opts.method=2, the grid is also split into tiles (slabs of planes in the
+// slowest dim), each owned by one thread and spread to by its own subprobs;
+// contributions to planes a tile doesn't own go to its halo buffer.
+// Slots (and halos) hold nvec strength vectors and subgrids, for fused
+// spreading of several vectors at the same NU pts.
+// If opts.balance=1, subprobs are runs of whole sort bins, capped in # NU pts
+// and subgrid volume, and are handed to threads in decreasing estimated cost.
+// With opts.spread_direction=2 the plan is instead for interpSorted's
+// subgrid mode (opts.interp_method=1): slots hold just L2-sized subgrids.
+#undef SPREAD_PLAN
+#ifdef SINGLE
+#define SPREAD_PLAN spread_planf
+#else
+#define SPREAD_PLAN spread_plan
+#endif
+typedef struct SPREAD_PLAN {
+  int nb;            // number of subproblems
+  BIGINT *brk;       // length nb+1: subproblem breakpoints in sorted NU pt list
+  BIGINT *subgrid;   // length 6*nb: offset1,2,3 then size1,2,3 per subproblem
+  int *order;        // length nb: order in which threads take the subprobs
+  BIGINT maxM0;      // max # NU pts in any subproblem
+  BIGINT maxsize;    // max # grid pts (complex) in any subgrid
+  int nslots;        // # workers that may spread concurrently using the arena
+  int nvec;          // max # strength vectors spread at once (fused) per slot
+  BIGINT slotsize;   // # FLTs per worker slot (a multiple of 64 bytes)
+  FLT *arena;        // nslots*slotsize FLTs, 64-byte aligned
+  int ntiles;        // # owner-computes tiles, or 0 if not tiled
+  int *tilesub;      // length ntiles+1: subprob breakpoints of the tiles
+  BIGINT *tileplane; // length ntiles+1: tile t owns planes [tileplane[t],
+                     // tileplane[t+1]) in the slowest dim
+  BIGINT *halo;      // length 4*ntiles: lowest plane touched (maybe <0), # lower
+                     // and # upper halo planes, offset into halobuf (FLTs)
+  BIGINT halostride; // # FLTs in all tiles' halo planes for one vector
+  FLT *halobuf;      // nvec sets of all tiles' halo planes, 64-byte aligned
+} SPREAD_PLAN;
+
+// Optional cache of the kernel values of a fixed set of NU pts, in sorted
+// order, so that repeated spreads/interps (eg iterative solvers) need not
+// refold the pts nor re-evaluate the kernel. Built by setup_ker_cache (eg in
+// finufft_setpts, if opts.spread_kercache=1). Per-precision name as above.
+#undef KER_CACHE
+#ifdef SINGLE
+#define KER_CACHE ker_cachef
+#else
+#define KER_CACHE ker_cache
+#endif
+typedef struct KER_CACHE {
+  BIGINT M;          // # NU pts
+  int ndims;         // dimension
+  int ns;            // kernel width (nspread) the values are for
+  BIGINT *i0;        // length ndims*M: per pt, fine grid start index per dim
+  FLT *ker;          // length ndims*ns*M: per pt, ns kernel values per dim
+} KER_CACHE;
+
+// Layout of a uniform grid carrying g ghost pts per side (spread_opts.ghost=g)
+// in each used dim (Nd>1), periodic images of the grid pts near the other end.
+// Sets P[0..2] to the padded sizes (x fastest) and returns the index of grid
+// pt (0,0,0) in the padded array. g=0 gives the plain N1*N2*N3 grid.
+static inline BIGINT ghost_dims(BIGINT *P, BIGINT N1, BIGINT N2, BIGINT N3,
+                                int g)
+{
+  P[0] = (N1>1) ? N1+2*g : 1;
+  P[1] = (N2>1) ? N2+2*g : 1;
+  P[2] = (N3>1) ? N3+2*g : 1;
+  return ((N1>1) ? g : 0) + P[0]*(((N2>1) ? g : 0) + P[1]*((N3>1) ? g : 0));
+}
+
+// functions with no FLT in their signature need per-precision names...
+#undef KER_CACHE_BYTES
+#ifdef SINGLE
+#define KER_CACHE_BYTES ker_cache_bytesf
+#else
+#define KER_CACHE_BYTES ker_cache_bytes
+#endif
+
+// NU pt sort permutations (sort_indices below) are either BIGINT, or, when
+// there are few enough NU pts (sortidx32_fits), uint32_t, halving the index
+// traffic of sorting, spreading and interpolating; the routines taking them are
+// templates on this index type I, instantiated for both in spreadinterp.cpp.
+static inline bool sortidx32_fits(BIGINT M)
+{
+  return M <= (BIGINT)UINT32_MAX;
+}
+
 // things external (spreadinterp) interface needs...
 int spreadinterp(BIGINT N1, BIGINT N2, BIGINT N3, FLT *data_uniform,
 		 BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 		 FLT *data_nonuniform, spread_opts opts);
 int spreadcheck(BIGINT N1, BIGINT N2, BIGINT N3,
                  BIGINT M, FLT *kx, FLT *ky, FLT *kz, spread_opts opts);
-int indexSort(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, 
+template <class I>
+int indexSort(I* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, 
                FLT *kx, FLT *ky, FLT *kz, spread_opts opts);
-int interpSorted(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
+template <class I>
+void fold_sorted_pts(FLT *kxs, FLT *kys, FLT *kzs, I* sort_indices,
+                     BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, FLT *kx,
+                     FLT *ky, FLT *kz, spread_opts opts);
+template <class I>
+int setup_spread_plan(SPREAD_PLAN **spp, I* sort_indices, BIGINT N1,
+                      BIGINT N2, BIGINT N3, BIGINT M, FLT *kx, FLT *ky,
+                      FLT *kz, spread_opts opts, int did_sort, int nslots,
+                      int nvec);
+void destroy_spread_plan(SPREAD_PLAN *sp);
+double KER_CACHE_BYTES(BIGINT M, int ndims, spread_opts opts);
+template <class I>
+int setup_ker_cache(KER_CACHE **kcp, I* sort_indices, BIGINT N1,
+                    BIGINT N2, BIGINT N3, BIGINT M, FLT *kx, FLT *ky,
+                    FLT *kz, spread_opts opts);
+void destroy_ker_cache(KER_CACHE *kc);
+void wrap_ghosts(FLT *data_uniform, BIGINT N1, BIGINT N2, BIGINT N3, int nvec,
+                 const spread_opts &opts);
+template <class I>
+int interpSorted(I* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
 		      FLT *data_uniform,BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-		 FLT *data_nonuniform, spread_opts opts, int did_sort);
-int spreadSorted(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
+		 FLT *data_nonuniform, spread_opts opts, int did_sort,
+                 SPREAD_PLAN *sp, int slot0, int nvec, KER_CACHE *kc);
+template <class I>
+int spreadSorted(I* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
 		      FLT *data_uniform,BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-		 FLT *data_nonuniform, spread_opts opts, int did_sort);
-int spreadinterpSorted(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
+		 FLT *data_nonuniform, spread_opts opts, int did_sort,
+                 SPREAD_PLAN *sp, int slot0, int nvec, KER_CACHE *kc);
+template <class I>
+int spreadinterpSorted(I* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
 		      FLT *data_uniform,BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-		      FLT *data_nonuniform, spread_opts opts, int did_sort);
+		      FLT *data_nonuniform, spread_opts opts, int did_sort,
+                       SPREAD_PLAN *sp, int slot0, int nvec, KER_CACHE *kc);
 FLT evaluate_kernel(FLT x,const spread_opts &opts);
 FLT evaluate_kernel_noexp(FLT x,const spread_opts &opts);
 int setup_spreader(spread_opts &opts,FLT eps,double upsampfac,int kerevalmeth, int debug, int showwarn, int dim);
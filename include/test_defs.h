@@ -14,6 +14,7 @@
 // std stuff
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cstdio>
 #include <iostream>
 #include <iomanip>
@@ -25,4 +26,61 @@
 // for omp rand filling
 #define TEST_RANDCHUNK 1000000
 
+static inline int count_positional_args(int argc, char* argv[])
+// # args of a tester's command line before any trailing name=value ones,
+// counting argv[0]
+{
+  int npos = argc;
+  while (npos>1 && strchr(argv[npos-1],'='))
+    --npos;
+  return npos;
+}
+
+static inline int set_opts_from_args(int npos, int argc, char* argv[],
+                                     nufft_opts *opts)
+/* Sets fields of opts from the name=value args argv[npos..argc-1] of a
+   tester's command line (see count_positional_args), eg "spread_method=2
+   spread_ghost=1", where name is any int field of nufft_opts, or upsampfac.
+   They override the positional args. Returns 0, or 1 if a name is unknown
+   (with a message to stderr).
+*/
+{
+#define TEST_INTOPT(f) {#f, &opts->f}
+  struct { const char *name; int *field; } intopts[] = {
+    TEST_INTOPT(modeord), TEST_INTOPT(chkbnds), TEST_INTOPT(debug),
+    TEST_INTOPT(spread_debug), TEST_INTOPT(showwarn), TEST_INTOPT(nthreads),
+    TEST_INTOPT(fftw), TEST_INTOPT(spread_sort), TEST_INTOPT(spread_kerevalmeth),
+    TEST_INTOPT(spread_kerpad), TEST_INTOPT(spread_thread),
+    TEST_INTOPT(maxbatchsize), TEST_INTOPT(spread_nthr_atomic),
+    TEST_INTOPT(spread_max_sp_size), TEST_INTOPT(spread_method),
+    TEST_INTOPT(spread_kercache), TEST_INTOPT(spread_kercache_mb),
+    TEST_INTOPT(spread_copypts), TEST_INTOPT(spread_sortedio),
+    TEST_INTOPT(spread_ghost), TEST_INTOPT(spread_balance),
+    TEST_INTOPT(zeropad_once), TEST_INTOPT(numa), TEST_INTOPT(hugepages),
+    TEST_INTOPT(spread_interp_method), TEST_INTOPT(spread_binsize_x),
+    TEST_INTOPT(spread_binsize_y), TEST_INTOPT(spread_binsize_z),
+    TEST_INTOPT(spread_binorder), TEST_INTOPT(fftw_prune),
+    TEST_INTOPT(batch_pipeline), TEST_INTOPT(plan_cache)};
+#undef TEST_INTOPT
+  for (int a=npos; a<argc; ++a) {
+    const char *val = strchr(argv[a],'=') + 1;
+    size_t len = val - 1 - argv[a];
+    bool found = false;
+    if (len==strlen("upsampfac") && !strncmp(argv[a],"upsampfac",len)) {
+      opts->upsampfac = atof(val);
+      found = true;
+    }
+    for (auto &o : intopts)
+      if (len==strlen(o.name) && !strncmp(argv[a],o.name,len)) {
+        *o.field = atoi(val);
+        found = true;
+      }
+    if (!found) {
+      fprintf(stderr,"unknown option %s\n",argv[a]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
 #endif   // TEST_DEFS_H
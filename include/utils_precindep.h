@@ -5,6 +5,7 @@
 #define UTILS_PRECINDEP_H
 
 #include "dataTypes.h"
+#include <stddef.h>
 
 BIGINT next235even(BIGINT n);
 
@@ -22,6 +23,17 @@ class CNTime {
 // openmp helpers
 int get_num_threads_parallel_block();
 
+// aligned allocation helpers (align must be a power of 2, multiple of ptr size)
+void* alloc_aligned(size_t nbytes, size_t align);
+void free_aligned(void* ptr);
+
+// NUMA helper: interleave pages of an untouched array over nodes (Linux only)
+int numa_interleave(void* ptr, size_t nbytes);
+// and ask for transparent huge pages for a big array (Linux only)
+int advise_hugepages(void* ptr, size_t nbytes);
+// per-core data cache size (level 1 or 2), or a typical one if not detected
+size_t cache_bytes(int level);
+
 // thread-safe rand number generator for Windows platform
 #ifdef _WIN32
 #include <random>
@@ -1028,6 +1028,60 @@ typedef std::complex<float> fcomplex;
      else if (strcmp(fname[ifield],"spread_max_sp_size") == 0) {
        oc->spread_max_sp_size = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
      }
+     else if (strcmp(fname[ifield],"spread_method") == 0) {
+       oc->spread_method = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_kercache") == 0) {
+       oc->spread_kercache = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_kercache_mb") == 0) {
+       oc->spread_kercache_mb = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_copypts") == 0) {
+       oc->spread_copypts = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_sortedio") == 0) {
+       oc->spread_sortedio = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_ghost") == 0) {
+       oc->spread_ghost = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_balance") == 0) {
+       oc->spread_balance = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"zeropad_once") == 0) {
+       oc->zeropad_once = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"numa") == 0) {
+       oc->numa = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"hugepages") == 0) {
+       oc->hugepages = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_interp_method") == 0) {
+       oc->spread_interp_method = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_binsize_x") == 0) {
+       oc->spread_binsize_x = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_binsize_y") == 0) {
+       oc->spread_binsize_y = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_binsize_z") == 0) {
+       oc->spread_binsize_z = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"spread_binorder") == 0) {
+       oc->spread_binorder = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"fftw_prune") == 0) {
+       oc->fftw_prune = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"batch_pipeline") == 0) {
+       oc->batch_pipeline = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
+     else if (strcmp(fname[ifield],"plan_cache") == 0) {
+       oc->plan_cache = (int)round(*mxGetPr(mxGetFieldByNumber(om,idx,ifield)));
+     }
      else
        continue;
    }
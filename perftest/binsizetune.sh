@@ -0,0 +1,61 @@
+#!/bin/bash
+# Sweep of the spreader's NU pt sort bin sizes, to tune the heuristic in
+# ../src/spreadinterp.cpp:get_bin_sizes (or choose opts.spread_binsize_*) for
+# this hardware. For each dimension, grid shape and tolerance, times sorted
+# spreading plus interpolation with each bin shape, and reports the fastest,
+# and its speedup over the automatic choice (bins 0,0,0), which is listed
+# first. Timings include the sort. Use a quiet machine.
+# Usage:
+# double-prec:  ./binsizetune.sh
+# single-prec:  ./binsizetune.sh SINGLE
+# to keep the results:  ./binsizetune.sh | tee results/binsizetune_results.txt
+# Needs M and grid sizes big enough (>> L2 cache) to be meaningful.
+
+M=4e6       # problem size (# NU pts), also about # U pts in each grid
+
+#TESTTHREADS=$(./mymaxthreads.sh)      # max threads (hyperthreading)
+TESTTHREADS=$(./mynumcores.sh)        # one thread per core (no hyperthreading)
+
+if [[ $1 == "SINGLE" ]]; then
+    PREC=single
+    ST=./spreadtestndf
+    TOLS="1e-3 1e-5"
+else
+    PREC=double
+    ST=./spreadtestnd
+    TOLS="1e-3 1e-6 1e-9 1e-12"
+fi
+
+# grid shapes (fine grid sizes), incl pizza boxes, and bin shapes to try...
+GRIDS2="2048,2048 8192,512 512,8192"
+BINS2="0,0,0 16,4,1 32,8,1 16,16,1 64,16,1 32,32,1 64,64,1 128,32,1"
+GRIDS3="160,160,160 640,20,320 20,640,320 640,320,20"
+BINS3="0,0,0 16,4,4 8,8,8 16,8,8 32,4,4 32,8,8 32,8,16 16,16,16 64,4,4 16,20,4"
+
+echo "binsizetune output:"
+./mycpuinfo.sh
+export OMP_NUM_THREADS=$TESTTHREADS
+echo "$PREC-precision $OMP_NUM_THREADS-thread sort bin sweep: #NU = $M"
+
+for d in 2 3; do
+    if [[ $d == 2 ]]; then GRIDS=$GRIDS2; BINS=$BINS2; else GRIDS=$GRIDS3; BINS=$BINS3; fi
+    for N in $GRIDS; do
+        for TOL in $TOLS; do
+            echo
+            echo "${d}D grid $N, tol=$TOL:"
+            BEST=; TBEST=; TAUTO=
+            for B in $BINS; do
+                # args: dims M N tol sort flags debug kerpad kerevalmeth
+                # upsampfac method balance prefetch interp_method bins.
+                # Sum the dir=1 and dir=2 times...
+                T=$($ST $d $M $N $TOL 1 0 0 0 1 2 0 0 -1 0 $B | grep "NU pts in" | awk '{t+=$5} END {print t}')
+                echo "    bins $B:   $T s"
+                if [[ $B == "0,0,0" ]]; then TAUTO=$T; fi
+                if [[ -z $TBEST ]] || awk "BEGIN {exit !($T < $TBEST)}"; then
+                    TBEST=$T; BEST=$B
+                fi
+            done
+            echo "    best: bins $BEST ($TBEST s, $(awk "BEGIN {printf \"%.3g\", $TAUTO/$TBEST}")x auto)"
+        done
+    done
+done
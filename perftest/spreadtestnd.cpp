@@ -10,7 +10,7 @@
 
 void usage()
 {
-  printf("usage: spreadtestnd dims [M N [tol [sort [flags [debug [kerpad [kerevalmeth [upsampfac]]]]]]]]\n\twhere dims=1,2 or 3\n\tM=# nonuniform pts\n\tN=# uniform pts\n\ttol=requested accuracy\n\tsort=0 (don't sort NU pts), 1 (do), or 2 (maybe sort; default)\n\tflags: expert timing flags, 0 is default (see spreadinterp.h)\n\tdebug=0 (less text out), 1 (more), 2 (lots)\n\tkerpad=0 (no pad to mult of 4), 1 (do, for kerevalmeth=0 only)\n\tkerevalmeth=0 (direct), 1 (Horner ppval)\n\tupsampfac>1; 2 or 1.25 for Horner\n\nexample: ./spreadtestnd 1 1e6 1e6 1e-6 2 0 1\n");
+  printf("usage: spreadtestnd dims [M N [tol [sort [flags [debug [kerpad [kerevalmeth [upsampfac [method [balance [prefetch [interp_method [bins [bin_order [idx]]]]]]]]]]]]]]]\n\twhere dims=1,2 or 3\n\tM=# nonuniform pts\n\tN=# uniform pts (a cube), or its sizes per dim, eg 400,10,400\n\ttol=requested accuracy\n\tsort=0 (don't sort NU pts), 1 (do), or 2 (maybe sort; default)\n\tflags: expert timing flags, 0 is default (see spreadinterp.h)\n\tdebug=0 (less text out), 1 (more), 2 (lots)\n\tkerpad=0 (no pad to mult of 4), 1 (do, for kerevalmeth=0 only)\n\tkerevalmeth=0 (direct), 1 (Horner ppval)\n\tupsampfac>1; 2 or 1.25 for Horner\n\tmethod=0 (auto), 1 (subprobs w/ critical/atomic), 2 (owner-computes tiles), 3 (direct, single-thread); dir=1 only\n\tbalance=0 (equal-count subprobs), 1 (runs of whole bins, capped subgrids); dir=1 only\n\tprefetch=distance (in NU pts) of dir=2 stencil prefetch, 0 for none, -1 for auto (default), or -2 to also sweep distances 0,1,2,4,8 (timing dir=2 for each)\n\tinterp_method=0 (from grid), 1 (from L2-sized subgrid copies, sorted only); dir=2 only\n\tbins=sort bin sizes as bx,by,bz in grid pts (0 for auto, the default), eg 16,4,4\n\tbin_order=0 (Cartesian; default), 1 (Morton), 2 (Hilbert) order of sort bins, or -1 to also compare all three (subgrid volumes and dir=1 times)\n\tidx=0 (sort indices 32-bit if M fits, else 64; default), or -1 to also compare 64- vs 32-bit (sort, dir=1 and dir=2 times, and that results agree)\n\nexample: ./spreadtestnd 1 1e6 1e6 1e-6 2 0 1\n");
 }
 
 int main(int argc, char* argv[])
@@ -27,21 +27,31 @@ int main(int argc, char* argv[])
  * Magland; expanded by Barnett 1/14/17. Better cmd line args 3/13/17
  * indep setting N 3/27/17. parallel rand() & sort flag 3/28/17
  * timing_flags 6/14/17. debug control 2/8/18. sort=2 opt 3/5/18, pad 4/24/18.
- * ier=1 warning not error, upsampfac 6/14/20.
+ * ier=1 warning not error, upsampfac 6/14/20. t1 spread method, balance.
+ * interp prefetch distance & sweep. interp_method. sort bin sizes, order.
+ * 64- vs 32-bit sort index comparison.
  */
 {
   int d = 3;            // Cmd line args & their defaults:  default #dims
   double w, tol = 1e-6; // default (eg 1e-6 has nspread=7)
   BIGINT M = 1e6;       // default # NU pts
   BIGINT roughNg = 1e6; // default # U pts
+  BIGINT N1 = 0, N2 = 1, N3 = 1;  // U grid sizes, if given per dim
   int sort = 2;         // spread_sort
   int flags = 0;        // default
   int debug = 0;        // default
   int kerpad = 0;       // default
   int kerevalmeth = 1;  // default: Horner
   FLT upsampfac = 2.0;  // standard
+  int method = 0;       // t1 spread method: auto
+  int balance = 0;      // t1 subprobs: equal # NU pts
+  int prefetch = -1;    // t2 stencil prefetch distance: auto (-2: sweep)
+  int interp_method = 0; // t2 interp: from the grid
+  int bins[3] = {0,0,0}; // sort bin sizes: auto
+  int bin_order = 0;    // sort bin order: Cartesian (-1: compare all)
+  int idx = 0;          // sort index type: auto (-1: compare 64 vs 32 bit)
   
-  if (argc<2 || argc==3 || argc>11) {
+  if (argc<2 || argc==3 || argc>18) {
     usage(); return (argc>1);
   }
   sscanf(argv[1],"%d",&d);
@@ -53,8 +63,14 @@ int main(int argc, char* argv[])
     if (M<1) {
       printf("M (# NU pts) must be positive!\n"); usage(); return 1;
     }
-    sscanf(argv[3],"%lf",&w); roughNg = (BIGINT)w;
-    if (roughNg<1) {
+    double Nd[3] = {1,1,1};
+    if (sscanf(argv[3],"%lf,%lf,%lf",Nd,Nd+1,Nd+2)==d) {  // sizes per dim
+      N1 = (BIGINT)Nd[0]; N2 = (BIGINT)Nd[1]; N3 = (BIGINT)Nd[2];
+      roughNg = N1*N2*N3;
+    } else {
+      sscanf(argv[3],"%lf",&w); roughNg = (BIGINT)w;
+    }
+    if (roughNg<1 || N2<1 || N3<1) {
       printf("N (# U pts) must be positive!\n"); usage(); return 1;
     }
   }
@@ -91,11 +107,51 @@ int main(int argc, char* argv[])
       printf("upsampfac must be >1.0!\n"); usage(); return 1;
     }
   }
+  if (argc>11) {
+    sscanf(argv[11],"%d",&method);
+    if ((method<0) || (method>3)) {
+      printf("method must be 0, 1, 2 or 3!\n"); usage(); return 1;
+    }
+  }
+  if (argc>12)
+    sscanf(argv[12],"%d",&balance);
+  if (argc>13) {
+    sscanf(argv[13],"%d",&prefetch);
+    if (prefetch<-2) {
+      printf("prefetch must be >=-2!\n"); usage(); return 1;
+    }
+  }
+  if (argc>14) {
+    sscanf(argv[14],"%d",&interp_method);
+    if ((interp_method<0) || (interp_method>1)) {
+      printf("interp_method must be 0 or 1!\n"); usage(); return 1;
+    }
+  }
+  if (argc>15) {
+    if (sscanf(argv[15],"%d,%d,%d",bins,bins+1,bins+2)!=3 || bins[0]<0 || bins[1]<0 || bins[2]<0) {
+      printf("bins must be three sizes >=0, eg 16,4,4!\n"); usage(); return 1;
+    }
+  }
+  if (argc>16) {
+    sscanf(argv[16],"%d",&bin_order);
+    if ((bin_order<-1) || (bin_order>2)) {
+      printf("bin_order must be -1, 0, 1 or 2!\n"); usage(); return 1;
+    }
+  }
+  if (argc>17) {
+    sscanf(argv[17],"%d",&idx);
+    if ((idx<-1) || (idx>0)) {
+      printf("idx must be -1 or 0!\n"); usage(); return 1;
+    }
+  }
 
   int dodir1 = true;                        // control if dir=1 tested at all
-  BIGINT N = (BIGINT)round(pow(roughNg,1.0/d));     // Fourier grid size per dim
-  BIGINT Ng = (BIGINT)pow(N,d);                     // actual total grid points
-  BIGINT N2 = (d>=2) ? N : 1, N3 = (d==3) ? N : 1;  // the y and z grid sizes
+  if (!N1) {                                        // cube: size per dim
+    N1 = (BIGINT)round(pow(roughNg,1.0/d));
+    N2 = (d>=2) ? N1 : 1;                           // the y and z grid sizes
+    N3 = (d==3) ? N1 : 1;
+  }
+  BIGINT Ng = N1*N2*N3;                             // actual total grid points
   std::vector<FLT> kx(M),ky(1),kz(1),d_nonuniform(2*M);    // NU, Re & Im
   if (d>1) ky.resize(M);                           // only alloc needed coords
   if (d>2) kz.resize(M);
@@ -114,6 +170,14 @@ int main(int argc, char* argv[])
   opts.sort = sort;
   opts.flags = flags;
   opts.kerpad = kerpad;
+  opts.method = method;
+  opts.balance = balance;
+  opts.prefetch = std::max(prefetch,-1);
+  opts.interp_method = interp_method;
+  opts.bin_size_x = bins[0];
+  opts.bin_size_y = bins[1];
+  opts.bin_size_z = bins[2];
+  opts.bin_order = std::max(bin_order,0);
   opts.upsampfac = upsampfac;
   opts.nthreads = 0;  // max # threads used, or 0 to use what's avail
   opts.sort_threads = 0;
@@ -123,8 +187,8 @@ int main(int argc, char* argv[])
   // spread a single source, only for reference accuracy check...
   opts.spread_direction=1;
   d_nonuniform[0] = 1.0; d_nonuniform[1] = 0.0;   // unit strength
-  kx[0] = ky[0] = kz[0] = N/2.0;                  // at center
-  int ier = spreadinterp(N,N2,N3,d_uniform.data(),1,kx.data(),ky.data(),kz.data(),d_nonuniform.data(),opts);          // vector::data officially C++11 but works
+  kx[0] = N1/2.0; ky[0] = N2/2.0; kz[0] = N3/2.0;  // at center
+  int ier = spreadinterp(N1,N2,N3,d_uniform.data(),1,kx.data(),ky.data(),kz.data(),d_nonuniform.data(),opts);          // vector::data officially C++11 but works
   if (ier!=0) {
     printf("error when spreading M=1 pt for ref acc check (ier=%d)!\n",ier);
     return ier;
@@ -143,10 +207,10 @@ int main(int argc, char* argv[])
     unsigned int se=MY_OMP_GET_THREAD_NUM();  // needed for parallel random #s
 #pragma omp for schedule(dynamic,1000000) reduction(+:strre,strim)
     for (BIGINT i=0; i<M; ++i) {
-      kx[i]=rand01r(&se)*N;
+      kx[i]=rand01r(&se)*N1;
       //kx[i]=2.0*kx[i] - 50.0;      //// to test folding within +-1 period
-      if (d>1) ky[i]=rand01r(&se)*N;      // only fill needed coords
-      if (d>2) kz[i]=rand01r(&se)*N;
+      if (d>1) ky[i]=rand01r(&se)*N2;     // only fill needed coords
+      if (d>2) kz[i]=rand01r(&se)*N3;
       d_nonuniform[i*2]=randm11r(&se);
       d_nonuniform[i*2+1]=randm11r(&se);
       strre += d_nonuniform[2*i]; 
@@ -158,7 +222,7 @@ int main(int argc, char* argv[])
   if (dodir1) {   // test direction 1 (NU -> U spreading) ......................
     printf("spreadinterp %dD, %.3g U pts, dir=%d, tol=%.3g: nspread=%d\n",d,(double)Ng,opts.spread_direction,tol,opts.nspread);
     timer.start();
-    ier = spreadinterp(N,N2,N3,d_uniform.data(),M,kx.data(),ky.data(),kz.data(),d_nonuniform.data(),opts);
+    ier = spreadinterp(N1,N2,N3,d_uniform.data(),M,kx.data(),ky.data(),kz.data(),d_nonuniform.data(),opts);
     t=timer.elapsedsec();
     if (ier!=0) {
       printf("error (ier=%d)!\n",ier);
@@ -192,17 +256,17 @@ int main(int argc, char* argv[])
     unsigned int s=MY_OMP_GET_THREAD_NUM();  // needed for parallel random #s
 #pragma omp for schedule(dynamic,1000000)
       for (BIGINT i=0; i<M; ++i) {       // random target pts
-        //kx[i]=10+.9*rand01r(&s)*N;   // or if want to keep ns away from edges
-	kx[i]=rand01r(&s)*N;
-	if (d>1) ky[i]=rand01r(&s)*N;
-	if (d>2) kz[i]=rand01r(&s)*N;
+        //kx[i]=10+.9*rand01r(&s)*N1;   // or if want to keep ns away from edges
+	kx[i]=rand01r(&s)*N1;
+	if (d>1) ky[i]=rand01r(&s)*N2;
+	if (d>2) kz[i]=rand01r(&s)*N3;
       }
   }
 
   opts.spread_direction=2;
   printf("spreadinterp %dD, %.3g U pts, dir=%d, tol=%.3g: nspread=%d\n",d,(double)Ng,opts.spread_direction,tol,opts.nspread);
   timer.restart();
-  ier = spreadinterp(N,N2,N3,d_uniform.data(),M,kx.data(),ky.data(),kz.data(),d_nonuniform.data(),opts);
+  ier = spreadinterp(N1,N2,N3,d_uniform.data(),M,kx.data(),ky.data(),kz.data(),d_nonuniform.data(),opts);
   t=timer.elapsedsec();
   if (ier!=0) {
     printf("error (ier=%d)!\n",ier);
@@ -223,5 +287,103 @@ int main(int argc, char* argv[])
   // each NU pt. However, it cannot detect reading
   // from wrong grid pts (they are all unity)
 
+  if (prefetch==-2) {    // benchmark mode: time dir=2 for prefetch distances
+    int dists[] = {0,1,2,4,8};
+    for (int k=0; k<5; ++k) {
+      opts.prefetch = dists[k];
+      timer.restart();
+      ier = spreadinterp(N1,N2,N3,d_uniform.data(),M,kx.data(),ky.data(),kz.data(),d_nonuniform.data(),opts);
+      t=timer.elapsedsec();
+      if (ier!=0) {
+        printf("error (ier=%d)!\n",ier);
+        return 1;
+      }
+      printf("    prefetch=%d:\t%.3g NU pts in %.3g s \t%.3g pts/s\n",dists[k],(double)M,t,M/t);
+    }
+    opts.prefetch = -1;
+  }
+
+  if (bin_order==-1) {   // benchmark mode: subgrids & dir=1 time per bin order
+    const char* names[] = {"Cartesian","Morton","Hilbert"};
+    std::vector<BIGINT> sort_indices(M);
+    opts.spread_direction = 1;
+    opts.debug = 0;
+    for (int o=0; o<3; ++o) {
+      opts.bin_order = o;
+      int did_sort = indexSort(sort_indices.data(),N1,N2,N3,M,kx.data(),ky.data(),kz.data(),opts);
+      SPREAD_PLAN *sp;
+      ier = setup_spread_plan(&sp,sort_indices.data(),N1,N2,N3,M,kx.data(),ky.data(),kz.data(),opts,did_sort,1,1);
+      if (ier!=0) {
+        printf("error (ier=%d)!\n",ier);
+        return 1;
+      }
+      double tsize = 0.0;           // sum and max of subgrid volumes
+      BIGINT maxsize = 0;
+      for (int k=0; k<sp->nb; ++k) {
+        BIGINT *g = sp->subgrid + 6*k;
+        tsize += (double)g[3]*g[4]*g[5];
+        maxsize = std::max(maxsize,g[3]*g[4]*g[5]);
+      }
+      int nb = sp->nb;
+      destroy_spread_plan(sp);
+      timer.restart();              // (includes the sort)
+      ier = spreadinterp(N1,N2,N3,d_uniform.data(),M,kx.data(),ky.data(),kz.data(),d_nonuniform.data(),opts);
+      t=timer.elapsedsec();
+      if (ier!=0) {
+        printf("error (ier=%d)!\n",ier);
+        return 1;
+      }
+      printf("    %-9s bins:\t%d subprobs, total subgrid %.3g*N, max %.3g*N; dir=1 %.3g s\n",names[o],nb,tsize/Ng,maxsize/(double)Ng,t);
+    }
+  }
+  if (idx==-1 && !sortidx32_fits(M))
+    printf("    M too big for 32-bit sort indices: not comparing\n");
+  else if (idx==-1) {    // benchmark mode: 64- vs 32-bit sort indices
+    // each spreads the random strengths, then interps from that grid; the
+    // two visit the NU pts in the same order, so agree to rounding (exactly
+    // on one thread, but with more the subproblems' adds to the grid race)
+    std::vector<BIGINT> si64(M);
+    std::vector<uint32_t> si32(M);
+    std::vector<FLT> du[2] = {std::vector<FLT>(2*Ng), std::vector<FLT>(2*Ng)};
+    std::vector<FLT> dn[2] = {std::vector<FLT>(2*M), std::vector<FLT>(2*M)};
+#pragma omp parallel
+    {
+      unsigned int se=MY_OMP_GET_THREAD_NUM();
+#pragma omp for schedule(dynamic,1000000)
+      for (BIGINT i=0; i<M; ++i) {     // random strengths
+        dn[0][2*i] = dn[1][2*i] = randm11r(&se);
+        dn[0][2*i+1] = dn[1][2*i+1] = randm11r(&se);
+      }
+    }
+    opts.debug = 0;
+    auto run = [&](auto *si, int k, const char *name) {
+      timer.restart();
+      int did_sort = indexSort(si,N1,N2,N3,M,kx.data(),ky.data(),kz.data(),opts);
+      double ts = timer.elapsedsec();
+      opts.spread_direction = 1;
+      timer.restart();
+      spreadinterpSorted(si,N1,N2,N3,du[k].data(),M,kx.data(),ky.data(),kz.data(),dn[k].data(),opts,did_sort,NULL,0,1,NULL);
+      double t1 = timer.elapsedsec();
+      opts.spread_direction = 2;
+      timer.restart();
+      spreadinterpSorted(si,N1,N2,N3,du[k].data(),M,kx.data(),ky.data(),kz.data(),dn[k].data(),opts,did_sort,NULL,0,1,NULL);
+      printf("    %s sort indices:\tsort %.3g s, dir=1 %.3g s, dir=2 %.3g s\n",name,ts,t1,timer.elapsedsec());
+    };
+    run(si64.data(),0,"64-bit");
+    run(si32.data(),1,"32-bit");
+    FLT d1 = 0.0, d2 = 0.0;         // max differences of grids and NU outputs
+    FLT n1 = 0.0, n2 = 0.0;         // and max norms of the 64-bit ones
+    for (BIGINT i=0; i<2*Ng; ++i) {
+      d1 = std::max(d1,(FLT)fabs(du[0][i]-du[1][i]));
+      n1 = std::max(n1,(FLT)fabs(du[0][i]));
+    }
+    for (BIGINT i=0; i<2*M; ++i) {
+      d2 = std::max(d2,(FLT)fabs(dn[0][i]-dn[1][i]));
+      n2 = std::max(n2,(FLT)fabs(dn[0][i]));
+    }
+    printf("    64- vs 32-bit max rel diff: dir=1 %.3g, dir=2 %.3g\n",d1/n1,d2/n2);
+    if (d1 > 10*EPSILON*n1 || d2 > 10*EPSILON*n2)
+      return 1;
+  }
   return 0;
 }
@@ -37,3 +37,16 @@ echo "$PREC-precision $OMP_NUM_THREADS-thread tests: #NU = $M, #U = $N, tol = $T
 $ST 1 $M $N $TOL
 $ST 2 $M $N $TOL
 $ST 3 $M $N $TOL
+
+# t1 spread methods on one thread: subprobs (1) vs direct to grid (3), at
+# density M/N = 1 and 0.1 (auto uses 3 except 3D at the higher density)...
+echo
+echo "$PREC-precision $OMP_NUM_THREADS-thread t1 method 1 vs 3: #U = $N, tol = $TOL..."
+for D in 1 2 3; do
+    for MM in $M 1e5; do
+        for METH in 1 3; do
+            echo "dim $D, #NU = $MM, method $METH:"
+            $ST $D $MM $N $TOL 2 0 0 0 1 2.0 $METH | grep -A1 "dir=1"
+        done
+    done
+done
@@ -77,7 +77,25 @@ NufftOpts._fields_ = [('modeord', c_int),
                       ('spread_thread', c_int),
                       ('maxbatchsize', c_int),
                       ('spread_nthr_atomic', c_int),
-                      ('spread_max_sp_size', c_int)]
+                      ('spread_max_sp_size', c_int),
+                      ('spread_method', c_int),
+                      ('spread_kercache', c_int),
+                      ('spread_kercache_mb', c_int),
+                      ('spread_copypts', c_int),
+                      ('spread_sortedio', c_int),
+                      ('spread_ghost', c_int),
+                      ('spread_balance', c_int),
+                      ('zeropad_once', c_int),
+                      ('numa', c_int),
+                      ('hugepages', c_int),
+                      ('spread_interp_method', c_int),
+                      ('spread_binsize_x', c_int),
+                      ('spread_binsize_y', c_int),
+                      ('spread_binsize_z', c_int),
+                      ('spread_binorder', c_int),
+                      ('fftw_prune', c_int),
+                      ('batch_pipeline', c_int),
+                      ('plan_cache', c_int)]
 
 
 FinufftPlan = c_void_p
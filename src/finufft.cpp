@@ -78,7 +78,8 @@ Design notes for guru interface implementation:
   since that would only survive in the scope of each function.
 
 * Thread-safety: FINUFFT plans are passed as pointers, so it has no global
-  state apart from that associated with FFTW (and the did_fftw_init).
+  state apart from that associated with FFTW (and the did_fftw_init), and
+  the opts.plan_cache cache of FFTW plans and kernel series (OMP critical).
 */
 
 
@@ -124,6 +125,14 @@ int setup_spreader_for_nufft(spread_opts &spopts, FLT eps, nufft_opts opts, int
     spopts.atomic_threshold = opts.spread_nthr_atomic;
   if (opts.spread_max_sp_size>0)      // overrides
     spopts.max_subproblem_size = opts.spread_max_sp_size;
+  spopts.method = opts.spread_method;
+  spopts.balance = opts.spread_balance;
+  spopts.numa = opts.numa;
+  spopts.interp_method = opts.spread_interp_method;
+  spopts.bin_size_x = opts.spread_binsize_x;
+  spopts.bin_size_y = opts.spread_binsize_y;
+  spopts.bin_size_z = opts.spread_binsize_z;
+  spopts.bin_order = opts.spread_binorder;
   return ier;
 } 
 
@@ -264,11 +273,31 @@ void onedim_nuft_kernel(BIGINT nk, FLT *k, FLT *phihat, spread_opts opts)
   }
 }  
 
-void deconvolveshuffle1d(int dir,FLT prefac,FLT* ker, BIGINT ms,
-			 FLT *fk, BIGINT nf1, FFTW_CPX* fw, int modeord)
+static inline void deconvolve_span(int dir, FLT prefac, FLT *kerinv,
+                                   int kstep, BIGINT n, FLT *fk, FLT *fw)
+// n consecutive complex modes: fk[j] = prefac*kerinv[kstep*j]*fw[j] if dir==1,
+// else the reverse. kstep is +1 or -1 (a literal, so each loop vectorizes).
+{
+  if (dir==1)
+    for (BIGINT j=0;j<n;++j) {
+      FLT a = prefac*kerinv[kstep*j];
+      fk[2*j] = a*fw[2*j]; fk[2*j+1] = a*fw[2*j+1];
+    }
+  else
+    for (BIGINT j=0;j<n;++j) {
+      FLT a = prefac*kerinv[kstep*j];
+      fw[2*j] = a*fk[2*j]; fw[2*j+1] = a*fk[2*j+1];
+    }
+}
+
+void deconvolveshuffle1d(int dir,FLT prefac,FLT* kerinv, BIGINT ms,
+			 FLT *fk, BIGINT nf1, FFTW_CPX* fw, int modeord,
+			 BIGINT ka, BIGINT kb)
 /*
-  if dir==1: copies fw to fk with amplification by prefac/ker
-  if dir==2: copies fk to fw (and zero pads rest of it), same amplification.
+  if dir==1: copies fw to fk with amplification by prefac*kerinv
+  if dir==2: copies fk to fw, same amplification. Does not zero pad fw.
+  Only does modes k in [ka,kb], a sub-range of [-ms/2,(ms-1)/2], so that
+  a long row can be split between threads (pass the full range otherwise).
 
   modeord=0: use CMCL-compatible mode ordering in fk (from -N/2 up to N/2-1)
           1: use FFT-style (from 0 to N/2-1, then -N/2 up to -1).
@@ -276,191 +305,308 @@ void deconvolveshuffle1d(int dir,FLT prefac,FLT* ker, BIGINT ms,
   fk is size-ms FLT complex array (2*ms FLTs alternating re,im parts)
   fw is a FFTW style complex array, ie FLT [nf1][2], essentially FLTs
        alternating re,im parts.
-  ker is real-valued FLT array of length nf1/2+1.
+  kerinv is real-valued FLT array of length nf1/2+1, the reciprocal of the
+       kernel Fourier series (so no divides in the inner loops).
 
-  Single thread only, but shouldn't matter since mostly data movement.
-
-  It has been tested that the repeated floating division in this inner loop
-  only contributes at the <3% level in 3D relative to the fftw cost (8 threads).
-  This could be removed by passing in an inverse kernel and doing mults.
-
-  todo: rewrite w/ C++-complex I/O, check complex divide not slower than
-        real divide, or is there a way to force a real divide?
+  Each sign of k is a contiguous chunk of both fk and fw, so is done as one
+  plain loop (kerinv read backwards for k<0) that the compiler vectorizes.
 
   Barnett 1/25/17. Fixed ms=0 case 3/14/17. modeord flag & clean 10/25/17
 */
 {
-  BIGINT kmin = -ms/2, kmax = (ms-1)/2;    // inclusive range of k indices
-  if (ms==0) kmax=-1;           // fixes zero-pad for trivial no-mode case
-  // set up pp & pn as ptrs to start of pos(ie nonneg) & neg chunks of fk array
-  BIGINT pp = -2*kmin, pn = 0;       // CMCL mode-ordering case (2* since cmplx)
-  if (modeord==1) { pp = 0; pn = 2*(kmax+1); }   // or, instead, FFT ordering
-  if (dir==1) {    // read fw, write out to fk...
-    for (BIGINT k=0;k<=kmax;++k) {                    // non-neg freqs k
-      fk[pp++] = prefac * fw[k][0] / ker[k];          // re
-      fk[pp++] = prefac * fw[k][1] / ker[k];          // im
-    }
-    for (BIGINT k=kmin;k<0;++k) {                     // neg freqs k
-      fk[pn++] = prefac * fw[nf1+k][0] / ker[-k];     // re
-      fk[pn++] = prefac * fw[nf1+k][1] / ker[-k];     // im
-    }
-  } else {    // read fk, write out to fw w/ zero padding...
-    for (BIGINT k=kmax+1; k<nf1+kmin; ++k) {  // zero pad precisely where needed
-      fw[k][0] = fw[k][1] = 0.0; }
-    for (BIGINT k=0;k<=kmax;++k) {                    // non-neg freqs k
-      fw[k][0] = prefac * fk[pp++] / ker[k];          // re
-      fw[k][1] = prefac * fk[pp++] / ker[k];          // im
-    }
-    for (BIGINT k=kmin;k<0;++k) {                     // neg freqs k
-      fw[nf1+k][0] = prefac * fk[pn++] / ker[-k];     // re
-      fw[nf1+k][1] = prefac * fk[pn++] / ker[-k];     // im
-    }
+  BIGINT kmin = -ms/2;
+  FLT *fwf = (FLT*)fw;
+  BIGINT a = ka, b = min(kb,(BIGINT)-1);             // neg freqs k
+  if (a<=b) {
+    BIGINT q = modeord==1 ? a+ms : a-kmin;           // fk index of mode a
+    deconvolve_span(dir, prefac, kerinv-a, -1, b-a+1, fk+2*q, fwf+2*(nf1+a));
+  }
+  a = max(ka,(BIGINT)0); b = kb;                     // non-neg freqs k
+  if (a<=b) {
+    BIGINT q = modeord==1 ? a : a-kmin;
+    deconvolve_span(dir, prefac, kerinv+a, 1, b-a+1, fk+2*q, fwf+2*a);
   }
 }
 
-void deconvolveshuffle2d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
-			 BIGINT ms, BIGINT mt,
-			 FLT *fk, BIGINT nf1, BIGINT nf2, FFTW_CPX* fw,
-			 int modeord)
-/*
-  2D version of deconvolveshuffle1d, calls it on each x-line using 1/ker2 fac.
-
-  if dir==1: copies fw to fk with amplification by prefac/(ker1(k1)*ker2(k2)).
-  if dir==2: copies fk to fw (and zero pads rest of it), same amplification.
 
-  modeord=0: use CMCL-compatible mode ordering in fk (each dim increasing)
-          1: use FFT-style (pos then negative, on each dim)
-
-  fk is complex array stored as 2*ms*mt FLTs alternating re,im parts, with
-    ms looped over fast and mt slow.
-  fw is a FFTW style complex array, ie FLT [nf1*nf2][2], essentially FLTs
-       alternating re,im parts; again nf1 is fast and nf2 slow.
-  ker1, ker2 are real-valued FLT arrays of lengths nf1/2+1, nf2/2+1
-       respectively.
+// since this func is local only, we macro its name here...
+#ifdef SINGLE
+#define SORT_NU_PTS sort_nu_ptsf
+#define SETUP_SPREAD_PLAN_FOR_NUFFT setup_spread_plan_for_nufftf
+#define SETUP_KER_CACHE_FOR_NUFFT setup_ker_cache_for_nufftf
+#define PLACE_FINE_GRIDS place_fine_gridsf
+#define ADVISE_HUGEPAGES advise_hugepages_planf
+#else
+#define SORT_NU_PTS sort_nu_pts
+#define SETUP_SPREAD_PLAN_FOR_NUFFT setup_spread_plan_for_nufft
+#define SETUP_KER_CACHE_FOR_NUFFT setup_ker_cache_for_nufft
+#define PLACE_FINE_GRIDS place_fine_grids
+#define ADVISE_HUGEPAGES advise_hugepages_plan
+#endif
 
-  Barnett 2/1/17, Fixed mt=0 case 3/14/17. modeord 10/25/17
+void ADVISE_HUGEPAGES(FINUFFT_PLAN p, void *ptr, size_t nbytes, const char *name)
+/* If opts.hugepages, asks for the just-allocated big plan array ptr (nbytes)
+   to be backed by transparent huge pages, for fewer TLB misses in the random
+   gathers of spread/interp. Debug reports its # 4KB pages (TLB entries needed
+   without) and the # 2MB pages advised.
 */
 {
-  BIGINT k2min = -mt/2, k2max = (mt-1)/2;    // inclusive range of k2 indices
-  if (mt==0) k2max=-1;           // fixes zero-pad for trivial no-mode case
-  // set up pp & pn as ptrs to start of pos(ie nonneg) & neg chunks of fk array
-  BIGINT pp = -2*k2min*ms, pn = 0;   // CMCL mode-ordering case (2* since cmplx)
-  if (modeord==1) { pp = 0; pn = 2*(k2max+1)*ms; }  // or, instead, FFT ordering
-  if (dir==2)               // zero pad needed x-lines (contiguous in memory)
-    for (BIGINT j=nf1*(k2max+1); j<nf1*(nf2+k2min); ++j)  // sweeps all dims
-      fw[j][0] = fw[j][1] = 0.0;
-  for (BIGINT k2=0;k2<=k2max;++k2, pp+=2*ms)          // non-neg y-freqs
-    // point fk and fw to the start of this y value's row (2* is for complex):
-    deconvolveshuffle1d(dir,prefac/ker2[k2],ker1,ms,fk + pp,nf1,&fw[nf1*k2],modeord);
-  for (BIGINT k2=k2min;k2<0;++k2, pn+=2*ms)           // neg y-freqs
-    deconvolveshuffle1d(dir,prefac/ker2[-k2],ker1,ms,fk + pn,nf1,&fw[nf1*(nf2+k2)],modeord);
+  if (!p->opts.hugepages || !ptr)
+    return;
+  int nh = advise_hugepages(ptr, nbytes);
+  if (p->opts.debug) printf("[%s] %s %.3g MB: %lld 4KB pages, %d 2MB advised\n",__func__,name,1e-6*nbytes,(long long)(nbytes>>12),nh);
 }
 
-void deconvolveshuffle3d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
-			 FLT *ker3, BIGINT ms, BIGINT mt, BIGINT mu,
-			 FLT *fk, BIGINT nf1, BIGINT nf2, BIGINT nf3,
-			 FFTW_CPX* fw, int modeord)
-/*
-  3D version of deconvolveshuffle2d, calls it on each xy-plane using 1/ker3 fac.
+void PLACE_FINE_GRIDS(FINUFFT_PLAN p, FFTW_CPX *fw, BIGINT nfw, int n, bool zero)
+/* Places the pages of the n just-allocated fine grids fw (each nfw complex)
+   on NUMA nodes, as set by opts.numa: 1 interleaves them over all nodes
+   (Linux only, else ignored); 2 first touches them by zeroing in per-thread
+   static slabs, as used by the spreader's slab-local scheduling (see
+   spreadinterp.cpp:numa_slabs) and by FFTW threads. If zero, they are zeroed
+   thus regardless (after any interleaving). Otherwise first touch is left to
+   the first execute.
+*/
+{
+  if (p->opts.numa==1) {
+    CNTime timer; timer.start();
+    int nodes = numa_interleave(fw, sizeof(FFTW_CPX)*nfw*n);
+    if (p->opts.debug) printf("[%s] interleave fine grids over %d nodes:\t%.3g s\n",__func__,nodes,timer.elapsedsec());
+  }
+  if (p->opts.numa==2 || zero) {
+#pragma omp parallel num_threads(p->opts.nthreads)
+    for (int v=0; v<n; v++) {
+      FLT *fwv = (FLT*)(fw + nfw*v);
+#pragma omp for schedule(static)
+      for (BIGINT i=0; i<2*nfw; i++)
+        fwv[i] = 0.0;
+    }
+  }
+}
 
-  if dir==1: copies fw to fk with ampl by prefac/(ker1(k1)*ker2(k2)*ker3(k3)).
-  if dir==2: copies fk to fw (and zero pads rest of it), same amplification.
+template <class F>
+static int with_sort_indices(FINUFFT_PLAN p, F f)
+// calls f (eg a generic lambda) with the plan's NU pt sort permutation, as
+// the index type SORT_NU_PTS chose for it (uint32_t or BIGINT)
+{
+  if (p->sortIdx32)
+    return f((uint32_t*)p->sortIndices);
+  return f((BIGINT*)p->sortIndices);
+}
 
-  modeord=0: use CMCL-compatible mode ordering in fk (each dim increasing)
-          1: use FFT-style (pos then negative, on each dim)
+int SORT_NU_PTS(FINUFFT_PLAN p, FLT *xj, FLT *yj, FLT *zj)
+/* (Re)allocates the plan's sort permutation of its nj NU pts xj,yj,zj, with
+   32-bit indices if nj fits (halving the index RAM and the bandwidth of each
+   spread/interp's gather), else BIGINT, and bin-sorts them into it (see
+   spreadinterp.cpp:indexSort), setting p->didSort.
+   Returns 0 or ERR_SPREAD_ALLOC.
+*/
+{
+  free(p->sortIndices);                     // in case of repeated setpts
+  p->sortIdx32 = sortidx32_fits(p->nj);
+  size_t nbytes = (p->sortIdx32 ? sizeof(uint32_t) : sizeof(BIGINT))*p->nj;
+  p->sortIndices = malloc(nbytes);
+  if (!p->sortIndices) {
+    fprintf(stderr,"[%s] failed to allocate sortIndices!\n",__func__);
+    return ERR_SPREAD_ALLOC;
+  }
+  ADVISE_HUGEPAGES(p, p->sortIndices, nbytes, "sortIndices");
+  p->didSort = with_sort_indices(p, [&](auto si) {
+      return indexSort(si, p->nf1, p->nf2, p->nf3, p->nj, xj, yj, zj,
+                       p->spopts); });
+  return 0;
+}
 
-  fk is complex array stored as 2*ms*mt*mu FLTs alternating re,im parts, with
-    ms looped over fastest and mu slowest.
-  fw is a FFTW style complex array, ie FLT [nf1*nf2*nf3][2], effectively
-       FLTs alternating re,im parts; again nf1 is fastest and nf3 slowest.
-  ker1, ker2, ker3 are real-valued FLT arrays of lengths nf1/2+1, nf2/2+1,
-       and nf3/2+1 respectively.
+int SETUP_SPREAD_PLAN_FOR_NUFFT(FINUFFT_PLAN p)
+/* (Re)builds the spreader's plan for the now-sorted NU pts p->X,Y,Z, whose
+   arena has a slot for each thread that spreadinterpSortedBatch might use,
+   each holding the whole batch if spread_thread=3 (fused).
+   Returns 0 or an error code (spreader allocation failure).
+*/
+{
+  destroy_spread_plan(p->spreadPlan);       // in case of repeated setpts
+  int nslots = max(p->opts.nthreads, p->batchSize);   // spread_thread=1 or 2
+  int nvec = 1;
+  if (p->opts.spread_thread==3) {           // all threads share a fused batch
+    nslots = p->opts.nthreads;
+    nvec = p->batchSize;
+  }
+  int ier = with_sort_indices(p, [&](auto si) {
+      return setup_spread_plan(&p->spreadPlan, si, p->nf1, p->nf2, p->nf3,
+                               p->nj, p->X, p->Y, p->Z, p->spopts, p->didSort,
+                               nslots, nvec); });
+  if (ier)
+    fprintf(stderr,"[%s] failed to set up spreader plan!\n",__func__);
+  return ier;
+}
 
-  Barnett 2/1/17, Fixed mu=0 case 3/14/17. modeord 10/25/17
+int SETUP_KER_CACHE_FOR_NUFFT(FINUFFT_PLAN p)
+/* If opts.spread_kercache=1, (re)builds the spreader's cache of kernel values
+   for the now-sorted NU pts p->X,Y,Z, so that each execute reads rather than
+   evaluates them. If its RAM exceeds opts.spread_kercache_mb, warns and falls
+   back to no cache (evaluating kernels in each execute, as usual).
+   Returns 0 or an error code (spreader allocation failure).
 */
 {
-  BIGINT k3min = -mu/2, k3max = (mu-1)/2;    // inclusive range of k3 indices
-  if (mu==0) k3max=-1;           // fixes zero-pad for trivial no-mode case
-  // set up pp & pn as ptrs to start of pos(ie nonneg) & neg chunks of fk array
-  BIGINT pp = -2*k3min*ms*mt, pn = 0; // CMCL mode-ordering (2* since cmplx)
-  if (modeord==1) { pp = 0; pn = 2*(k3max+1)*ms*mt; }  // or FFT ordering
-  BIGINT np = nf1*nf2;  // # pts in an upsampled Fourier xy-plane
-  if (dir==2)           // zero pad needed xy-planes (contiguous in memory)
-    for (BIGINT j=np*(k3max+1);j<np*(nf3+k3min);++j)  // sweeps all dims
-      fw[j][0] = fw[j][1] = 0.0;
-  for (BIGINT k3=0;k3<=k3max;++k3, pp+=2*ms*mt)      // non-neg z-freqs
-    // point fk and fw to the start of this z value's plane (2* is for complex):
-    deconvolveshuffle2d(dir,prefac/ker3[k3],ker1,ker2,ms,mt,
-			fk + pp,nf1,nf2,&fw[np*k3],modeord);
-  for (BIGINT k3=k3min;k3<0;++k3, pn+=2*ms*mt)       // neg z-freqs
-    deconvolveshuffle2d(dir,prefac/ker3[-k3],ker1,ker2,ms,mt,
-			fk + pn,nf1,nf2,&fw[np*(nf3+k3)],modeord);
+  destroy_ker_cache(p->kerCache);           // in case of repeated setpts
+  p->kerCache = NULL;
+  if (!p->opts.spread_kercache || p->nj==0)
+    return 0;
+  double bytes = KER_CACHE_BYTES(p->nj, p->dim, p->spopts);
+  if (bytes > 1e6*p->opts.spread_kercache_mb) {
+    if (p->opts.showwarn)
+      fprintf(stderr,"[%s] warning: kernel cache needs %.3g GB > spread_kercache_mb=%d; not caching.\n",__func__,1e-9*bytes,p->opts.spread_kercache_mb);
+    return 0;
+  }
+  int ier = with_sort_indices(p, [&](auto si) {
+      return setup_ker_cache(&p->kerCache, si, p->nf1, p->nf2, p->nf3, p->nj,
+                             p->X, p->Y, p->Z, p->spopts); });
+  if (ier)
+    fprintf(stderr,"[%s] failed to set up kernel cache!\n",__func__);
+  return ier;
 }
 
 
 // --------- batch helper functions for t1,2 exec: ---------------------------
 
-int spreadinterpSortedBatch(int batchSize, FINUFFT_PLAN p, CPX* cBatch)
+int spreadinterpSortedBatch(int batchSize, FINUFFT_PLAN p, CPX* cBatch,
+                            FFTW_CPX* fwBatch, int nthr)
 /*
   Spreads (or interpolates) a batch of batchSize strength vectors in cBatch
-  to (or from) the batch of fine working grids p->fwBatch, using the same set of
-  (index-sorted) NU points p->X,Y,Z for each vector in the batch.
+  to (or from) the batch of fine working grids fwBatch (p->fwBatch, or with
+  opts.batch_pipeline also p->fwBatch2), using the same set of
+  (index-sorted) NU points p->X,Y,Z for each vector in the batch, with up to
+  nthr threads (p->opts.nthreads unless pipelined).
   The direction (spread vs interpolate) is set by p->spopts.spread_direction.
   Returns 0 (no error reporting for now).
   Notes:
   1) cBatch is already assumed to have the correct offset, ie here we
      read from the start of cBatch (unlike Malleo). fwBatch also has zero offset
   2) this routine is a batched version of spreadinterpSorted in spreadinterp.cpp
+  3) if the fine grids carry ghost pts (opts.spread_ghost), they are filled
+     before interpolating, and folded in after spreading (ie, before the FFT).
   Barnett 5/19/20, based on Malleo 2019.
 */
 {
-  // opts.spread_thread: 1 sequential multithread, 2 parallel single-thread.
-  // omp_sets_nested deprecated, so don't use; assume not nested for 2 to work.
-  // But when nthr_outer=1 here, omp par inside the loop sees all threads...
-  int nthr_outer = p->opts.spread_thread==1 ? 1 : batchSize;
-  
+  spread_opts spopts = p->spopts;
+  spopts.nthreads = nthr;
+  if (p->spopts.spread_direction==2)    // (no-op if no ghosts)
+    wrap_ghosts((FLT*)fwBatch, p->nf1, p->nf2, p->nf3, batchSize, spopts);
+  // opts.spread_thread: 1 sequential multithread, 2 parallel single-thread,
+  // 3 fused multithread (all vectors in one call, sharing kernel evaluations).
+  if (p->opts.spread_thread==3)
+    with_sort_indices(p, [&](auto si) {
+        return spreadinterpSorted(si, p->nf1, p->nf2, p->nf3,
+                                  (FLT*)fwBatch, p->nj, p->X, p->Y, p->Z,
+                                  (FLT*)cBatch, spopts, p->didSort,
+                                  p->spreadPlan, 0, batchSize, p->kerCache); });
+  else {
+    // omp_sets_nested deprecated, so don't use; assume not nested for 2 to work.
+    // But when nthr_outer=1 here, omp par inside the loop sees all threads...
+    int nthr_outer = p->opts.spread_thread==1 ? 1 : min(batchSize,nthr);
+    // for 2, each single-thread spread uses its own slot of the spreader arena
+    spread_opts spopts1 = spopts;
+    if (nthr_outer>1)
+      spopts1.nthreads = 1;
+    
 #pragma omp parallel for num_threads(nthr_outer)
-  for (int i=0; i<batchSize; i++) {
-    FFTW_CPX *fwi = p->fwBatch + i*p->nf;  // start of i'th fw array in wkspace
-    CPX *ci = cBatch + i*p->nj;            // start of i'th c array in cBatch
-    spreadinterpSorted(p->sortIndices, p->nf1, p->nf2, p->nf3, (FLT*)fwi, p->nj,
-                       p->X, p->Y, p->Z, (FLT*)ci, p->spopts, p->didSort);
+    for (int i=0; i<batchSize; i++) {
+      FFTW_CPX *fwi = fwBatch + i*p->nfw;     // start of i'th fw array in wkspace
+      CPX *ci = cBatch + i*p->nj;             // start of i'th c array in cBatch
+      with_sort_indices(p, [&](auto si) {
+          return spreadinterpSorted(si, p->nf1, p->nf2, p->nf3, (FLT*)fwi,
+                                    p->nj, p->X, p->Y, p->Z, (FLT*)ci, spopts1,
+                                    p->didSort, p->spreadPlan,
+                                    nthr_outer>1 ? i : 0, 1, p->kerCache); });
+    }
   }
+  if (p->spopts.spread_direction==1)
+    wrap_ghosts((FLT*)fwBatch, p->nf1, p->nf2, p->nf3, batchSize, spopts);
   return 0;
 }
 
-int deconvolveBatch(int batchSize, FINUFFT_PLAN p, CPX* fkBatch)
+int deconvolveBatch(int batchSize, FINUFFT_PLAN p, CPX* fkBatch,
+                    FFTW_CPX* fwBatch, int nthr)
 /*
-  Type 1: deconvolves (amplifies) from each interior fw array in p->fwBatch
+  Type 1: deconvolves (amplifies) from each interior fw array in fwBatch
   into each output array fk in fkBatch.
   Type 2: deconvolves from user-supplied input fk to 0-padded interior fw,
-  again looping over fk in fkBatch and fw in p->fwBatch.
+  again looping over fk in fkBatch and fw in fwBatch.
+  fwBatch is p->fwBatch, or with opts.batch_pipeline also p->fwBatch2, and
+  up to nthr threads are used (p->opts.nthreads unless pipelined).
+  Any ghost pts of the fw arrays are ignored here (see wrap_ghosts).
+  If p->fwPadBatch (t2 with opts.zeropad_once), fk goes there instead, and
+  its padding, zeroed at plan, is not touched.
   The direction (spread vs interpolate) is set by p->spopts.spread_direction.
-  This is mostly a loop calling deconvolveshuffle?d for the needed dim batchSize
-  times.
+  The work is split into x-lines of all the fw arrays (just the mode lines,
+  or in t2 all lines, the rest being zero padded), each done by a call to
+  deconvolveshuffle1d, so even a single 2D or 3D transform uses all threads.
+  In 1D each line is split into chunks instead when there are few arrays.
+  The kernel reciprocals p->phiHatInv? are from makeplan, so no divides.
   Barnett 5/21/20, simplified from Malleo 2019 (eg t3 logic won't be in here)
 */
 {
-  // since deconvolveshuffle?d are single-thread, omp par seems to help here...
-#pragma omp parallel for num_threads(batchSize)
-  for (int i=0; i<batchSize; i++) {
-    FFTW_CPX *fwi = p->fwBatch + i*p->nf;  // start of i'th fw array in wkspace
-    CPX *fki = fkBatch + i*p->N;           // start of i'th fk array in fkBatch
-    
-    // Call routine from common.cpp for the dim; prefactors hardcoded to 1.0...
-    if (p->dim == 1)
-      deconvolveshuffle1d(p->spopts.spread_direction, 1.0, p->phiHat1,
-                          p->ms, (FLT *)fki,
-                          p->nf1, fwi, p->opts.modeord);
-    else if (p->dim == 2)
-      deconvolveshuffle2d(p->spopts.spread_direction,1.0, p->phiHat1,
-                          p->phiHat2, p->ms, p->mt, (FLT *)fki,
-                          p->nf1, p->nf2, fwi, p->opts.modeord);
-    else
-      deconvolveshuffle3d(p->spopts.spread_direction, 1.0, p->phiHat1,
-                          p->phiHat2, p->phiHat3, p->ms, p->mt, p->mu,
-                          (FLT *)fki, p->nf1, p->nf2, p->nf3,
-                          fwi, p->opts.modeord);
+  BIGINT P[3];      // fw array sizes, incl any ghosts, hence its strides
+  ghost_dims(P, p->nf1, p->nf2, p->nf3, p->spopts.ghost);
+  FFTW_CPX *fw = fwBatch + p->fwoff;     // 1st fw's pt (0,0,0)
+  BIGINT nfw = p->nfw;
+  int dir = p->spopts.spread_direction, modeord = p->opts.modeord;
+  bool pad = (dir==2);                   // (t2) zero pad the rest of fw
+  if (p->fwPadBatch) {                   // plain arrays, already 0-padded
+    P[0] = p->nf1; P[1] = p->nf2;
+    fw = p->fwPadBatch;
+    nfw = p->nf;
+    pad = false;
+  }
+  BIGINT ms = p->ms, mt = p->mt, mu = p->mu, nf1 = p->nf1;
+  FLT one = 1.0;                         // kernel reciprocal in unused dims
+  FLT *kerinv2 = p->dim>1 ? p->phiHatInv2 : &one;   // (only k=0 used there)
+  FLT *kerinv3 = p->dim>2 ? p->phiHatInv3 : &one;
+  BIGINT k1min = -ms/2, k1max = (ms-1)/2;   // inclusive range of k1 indices
+  if (ms==0) k1max=-1;                   // fixes zero-pad for no-mode case
+
+  // maps a line index j along y or z (fw grid index if pad, else fk index)
+  // to its mode k and grid index g; returns false if in the zero pad gap...
+  auto line = [&](BIGINT j, BIGINT m, BIGINT nf, BIGINT &k, BIGINT &g) {
+    BIGINT kmin = -m/2, kmax = m ? (m-1)/2 : -1;
+    if (pad) {
+      g = j;
+      k = (j<=kmax) ? j : j-nf;
+      return j<=kmax || j>=nf+kmin;
+    }
+    k = (modeord==1) ? (j<=kmax ? j : j-m) : j+kmin;
+    g = (k>=0) ? k : nf+k;
+    return true;
+  };
+  auto fkidx = [&](BIGINT k, BIGINT m) {     // index of mode k in fk's dim
+    return (modeord==1) ? (k>=0 ? k : k+m) : k+m/2; };
+
+  BIGINT n2 = pad ? p->nf2 : mt, n3 = pad ? p->nf3 : mu;   // lines per fw
+  BIGINT nline = n2*n3;
+  BIGINT nc = 1;                 // # chunks per x-line (only >1 for few 1D)
+  if (p->dim==1)
+    nc = min((BIGINT)max(1, nthr/batchSize), 1 + nf1/16384);
+  BIGINT nu = (BIGINT)batchSize*nline*nc;    // # work units
+#pragma omp parallel for num_threads((int)min((BIGINT)nthr, nu)) schedule(static)
+  for (BIGINT u=0; u<nu; ++u) {
+    BIGINT c = u % nc, l = (u/nc) % nline, i = u/(nc*nline);
+    BIGINT k2, k3, g2, g3;
+    bool in2 = line(l % n2, mt, p->nf2, k2, g2);
+    bool in3 = line(l / n2, mu, p->nf3, k3, g3);
+    FFTW_CPX *fwl = fw + i*nfw + P[0]*(g2 + P[1]*g3);   // this x-line of fw
+    if (!in2 || !in3) {                  // (t2) whole x-line is zero pad
+      for (BIGINT j=nf1*c/nc; j<nf1*(c+1)/nc; ++j)
+        fwl[j][0] = fwl[j][1] = 0.0;
+      continue;
+    }
+    FLT *fkl = (FLT*)(fkBatch + i*p->N + ms*(fkidx(k2,mt) + mt*fkidx(k3,mu)));
+    deconvolveshuffle1d(dir, kerinv2[k2>=0 ? k2 : -k2]*kerinv3[k3>=0 ? k3 : -k3],
+                        p->phiHatInv1, ms, fkl, nf1, fwl, modeord,
+                        k1min + ms*c/nc, k1min + ms*(c+1)/nc - 1);
+    if (pad) {                           // this chunk of the x-line's gap
+      BIGINT ng = nf1-ms, j0 = k1max+1;
+      for (BIGINT j=j0+ng*c/nc; j<j0+ng*(c+1)/nc; ++j)
+        fwl[j][0] = fwl[j][1] = 0.0;
+    }
   }
   return 0;
 }
@@ -496,6 +642,529 @@ int* GRIDSIZE_FOR_FFTW(FINUFFT_PLAN p){
 }
 
 
+#ifdef SINGLE
+#define PLAN_FFTW_PASSES plan_fftw_passesf
+#else
+#define PLAN_FFTW_PASSES plan_fftw_passes
+#endif
+
+int PLAN_FFTW_PASSES(FINUFFT_PLAN p, FFTW_CPX *fw0, BIGINT *P, int howmany,
+                     FFTW_PLAN *passes)
+/* Plans the type 1 or 2 FFT of the batch of howmany fine grids at fw0 (pt
+   (0,0,0) of the first; strides P[0], P[0]*P[1] incl ghosts, and nfw between
+   arrays) as separable in-place 1D passes, writing them in exec order to
+   passes (p->fftwPasses, or p->fftwRemPasses for the last batch).
+   Only the mode-holding indices [0,(m-1)/2] and [nf-m/2,nf) of each dim are
+   ever nonzero in the t2 input or read from the t1 output, so a pass along
+   dim d need only do the lines whose indices in the higher dims e>d lie in
+   these mode blocks: t2 does x,y,z (the higher dims are still zero outside
+   them), t1 does z,y,x (only their mode blocks are read from then on). The
+   lower dims are done in full. So a pass is one guru plan per combination of
+   the higher dims' blocks (empty ones skipped). For upsampfac=2 this does
+   7/12 of the 1D FFTs of the full 3D FFT, or 3/4 in 2D.
+   Returns the number of passes, whose first line offsets from fw0 go in
+   p->fftwPassOff. For opts.fftw_prune.
+*/
+{
+  int dim = p->dim;
+  BIGINT nf[3] = {p->nf1, p->nf2, p->nf3}, m[3] = {p->ms, p->mt, p->mu};
+  BIGINT str[3] = {1, P[0], P[0]*P[1]};
+  BIGINT lo[3][2], len[3][2];       // the two mode blocks of each dim
+  for (int d=0; d<dim; ++d) {
+    lo[d][0] = 0;              len[d][0] = m[d] - m[d]/2;   // k>=0
+    lo[d][1] = nf[d] - m[d]/2; len[d][1] = m[d]/2;          // k<0
+  }
+  int n = 0;
+  for (int pass=0; pass<dim; ++pass) {
+    int d = (p->type==2) ? pass : dim-1-pass;   // dim transformed
+    FFTW_IODIM tdim = {(int)nf[d], (int)str[d], (int)str[d]};
+    for (int c=0; c < (1<<(dim-1-d)); ++c) {    // combos of higher dim blocks
+      FFTW_IODIM hdims[3];                      // lines: other dims, batch
+      int nh = 0;
+      BIGINT off = 0;
+      bool empty = false;
+      for (int e=0; e<dim; ++e) {
+        if (e==d) continue;
+        BIGINT ne = nf[e];
+        if (e>d) {
+          int b = (c>>(e-d-1)) & 1;
+          ne = len[e][b];
+          off += lo[e][b]*str[e];
+        }
+        empty |= (ne==0);
+        hdims[nh++] = {(int)ne, (int)str[e], (int)str[e]};
+      }
+      hdims[nh++] = {howmany, (int)p->nfw, (int)p->nfw};
+      if (empty) continue;
+      p->fftwPassOff[n] = off;
+      passes[n++] = FFTW_PLAN_GURU_DFT(1, &tdim, nh, hdims, fw0 + off,
+                                       fw0 + off, p->fftSign, p->opts.fftw);
+    }
+  }
+  return n;
+}
+
+// ------- process-wide cache of FFTW plans and kernel Fourier series -------
+// For opts.plan_cache=1 (t1,2, and t3's inner t2): plans with the same fine
+// grid FFT (sizes, batch, sign, FFTW flags and threads, ghosts, pruning)
+// share its FFTW plan(s), and plans with the same fine grid size and kernel
+// share the reciprocal kernel Fourier series, so a hit skips FFTW planning
+// and onedim_fseries_kernel in makeplan. Each plan runs a shared FFTW plan
+// by new-array execute on its own fwBatch (FFTW_ALLOC_CPX, hence aligned as
+// the one planned). Entries count the finufft plans using them; up to
+// PLAN_CACHE_MAX unused ones of each kind are kept, the least recently used
+// being evicted. One cache per precision (this file is compiled once for
+// each), accessed only inside the named OMP critical below.
+
+#ifdef SINGLE
+#define PLAN_CACHE plan_cachef
+#define FFTW_CACHE_ENTRY fftw_cache_entryf
+#define SER_CACHE_ENTRY ser_cache_entryf
+#define PHIHATINV_FOR_NUFFT phihatinv_for_nufftf
+#define FREE_PHIHATINV free_phihatinvf
+#define DESTROY_FFTW_PLANS destroy_fftw_plansf
+#else
+#define PLAN_CACHE plan_cache
+#define FFTW_CACHE_ENTRY fftw_cache_entry
+#define SER_CACHE_ENTRY ser_cache_entry
+#define PHIHATINV_FOR_NUFFT phihatinv_for_nufft
+#define FREE_PHIHATINV free_phihatinv
+#define DESTROY_FFTW_PLANS destroy_fftw_plans
+#endif
+
+#define FFTW_CACHE_NKEY 15
+struct FFTW_CACHE_ENTRY {        // FFTW plan(s) for one batch of fine grids
+  BIGINT key[FFTW_CACHE_NKEY];   // see PLAN_FFTW_FOR_NUFFT
+  FFTW_PLAN plan;                // full FFT, or NULL if pruned passes:
+  FFTW_PLAN passes[7];
+  int npasses;
+  BIGINT passOff[7];
+  int refs;                      // # finufft plans using it
+  BIGINT lastuse;                // cache clock at last acquire or release
+};
+struct SER_CACHE_ENTRY {         // reciprocal kernel Fourier series
+  BIGINT nf;                     // key: fine grid size, kernel width and
+  int ns;                        // beta, upsampfac
+  FLT beta;
+  double upsampfac;
+  FLT *phiHatInv;                // nf/2+1 FLTs
+  int refs;
+  BIGINT lastuse;
+};
+static struct PLAN_CACHE {
+  std::vector<FFTW_CACHE_ENTRY> fftw;
+  std::vector<SER_CACHE_ENTRY> ser;
+  BIGINT clock;                    // counts acquires and releases
+  BIGINT hits[2], misses[2];       // [0] FFTW plans, [1] kernel series
+} planCache;
+
+template <class E, class F>
+static int evict_unused(std::vector<E> &v, int maxunused, F destroy)
+// Destroys and removes least recently used entries of v with no plans
+// using them, until at most maxunused are left. Returns # entries in use.
+{
+  while (true) {
+    int nunused = 0;
+    size_t lru = v.size();
+    for (size_t i=0; i<v.size(); ++i)
+      if (!v[i].refs) {
+        ++nunused;
+        if (lru==v.size() || v[i].lastuse < v[lru].lastuse) lru = i;
+      }
+    if (nunused<=maxunused) return (int)v.size() - nunused;
+    destroy(v[lru]);
+    v.erase(v.begin() + lru);
+  }
+}
+
+static void destroy_fftw_entry(FFTW_CACHE_ENTRY &e)
+{
+  if (e.plan) FFTW_DE(e.plan);
+  for (int i=0; i<e.npasses; ++i) FFTW_DE(e.passes[i]);
+}
+
+static void free_ser_entry(SER_CACHE_ENTRY &e) { free(e.phiHatInv); }
+
+FLT *PHIHATINV_FOR_NUFFT(FINUFFT_PLAN p, BIGINT nf)
+/* Returns the reciprocals of the kernel Fourier series on a size-nf fine
+   grid (nf/2+1 FLTs, see onedim_fseries_kernel), as used by deconvolve.
+   Newly malloc'd, or with opts.plan_cache, shared from the cache.
+   Free with FREE_PHIHATINV.
+*/
+{
+  auto make = [&]() {
+    FLT *a = (FLT*)malloc(sizeof(FLT)*(nf/2 + 1));
+    onedim_fseries_kernel(nf, a, p->spopts);
+    for (BIGINT k=0; k<=nf/2; ++k)    // so deconvolve multiplies
+      a[k] = 1.0 / a[k];
+    return a;
+  };
+  if (!p->opts.plan_cache)
+    return make();
+  FLT *a = NULL;
+#pragma omp critical (finufft_plan_cache)
+  {
+    for (auto &e : planCache.ser)
+      if (e.nf==nf && e.ns==p->spopts.nspread && e.beta==p->spopts.ES_beta &&
+          e.upsampfac==p->spopts.upsampfac) {
+        a = e.phiHatInv;
+        ++e.refs;
+        e.lastuse = ++planCache.clock;
+        ++planCache.hits[1];
+        break;
+      }
+    if (!a) {
+      a = make();
+      planCache.ser.push_back({nf, p->spopts.nspread, p->spopts.ES_beta,
+                               p->spopts.upsampfac, a, 1, ++planCache.clock});
+      ++planCache.misses[1];
+      evict_unused(planCache.ser, PLAN_CACHE_MAX, free_ser_entry);
+    }
+  }
+  return a;
+}
+
+void FREE_PHIHATINV(FINUFFT_PLAN p, FLT *a)
+// Frees a from PHIHATINV_FOR_NUFFT, or releases it to the cache. NULL is ok.
+{
+  if (!a) return;
+  if (!p->opts.plan_cache) {
+    free(a);
+    return;
+  }
+#pragma omp critical (finufft_plan_cache)
+  {
+    for (auto &e : planCache.ser)
+      if (e.phiHatInv==a) {
+        --e.refs;
+        e.lastuse = ++planCache.clock;
+        break;
+      }
+    evict_unused(planCache.ser, PLAN_CACHE_MAX, free_ser_entry);
+  }
+}
+
+void DESTROY_FFTW_PLANS(FINUFFT_PLAN p)
+/* Destroys the t1,2 FFTW plans (full and short last batch) of p, or with
+   opts.plan_cache, releases them to the cache. Leaves p with none.
+*/
+{
+  bool rem = (p->remBatchSize > 0);
+  if (p->opts.plan_cache) {
+    // a plan's first FFTW plan identifies its cache entry...
+    FFTW_PLAN first[2] = {p->nfftwPasses ? p->fftwPasses[0] : p->fftwPlan,
+                          p->nfftwPasses && rem ? p->fftwRemPasses[0] : p->fftwPlanRem};
+#pragma omp critical (finufft_plan_cache)
+    {
+      for (int j=0; j<2; ++j)
+        for (auto &e : planCache.fftw)
+          if (first[j] && (e.npasses ? e.passes[0] : e.plan)==first[j]) {
+            --e.refs;
+            e.lastuse = ++planCache.clock;
+            break;
+          }
+      evict_unused(planCache.fftw, PLAN_CACHE_MAX, destroy_fftw_entry);
+    }
+  } else {
+    if (p->fftwPlan) FFTW_DE(p->fftwPlan);
+    if (p->fftwPlanRem) FFTW_DE(p->fftwPlanRem);
+    for (int i=0; i<p->nfftwPasses; ++i) {
+      FFTW_DE(p->fftwPasses[i]);
+      if (rem) FFTW_DE(p->fftwRemPasses[i]);
+    }
+  }
+  p->fftwPlan = NULL;
+  p->fftwPlanRem = NULL;
+  p->nfftwPasses = 0;
+}
+
+void FINUFFT_CACHE_STATS(BIGINT *stats)
+// See docs/cguru.doc
+{
+#pragma omp critical (finufft_plan_cache)
+  {
+    stats[0] = planCache.hits[0];
+    stats[1] = planCache.misses[0];
+    stats[2] = planCache.fftw.size();
+    stats[3] = planCache.hits[1];
+    stats[4] = planCache.misses[1];
+    stats[5] = planCache.ser.size();
+  }
+}
+
+int FINUFFT_CACHE_CLEAR()
+// See docs/cguru.doc
+{
+  int inuse;
+#pragma omp critical (finufft_plan_cache)
+  {
+    inuse = evict_unused(planCache.fftw, 0, destroy_fftw_entry);
+    inuse += evict_unused(planCache.ser, 0, free_ser_entry);
+    planCache.hits[0] = planCache.hits[1] = 0;
+    planCache.misses[0] = planCache.misses[1] = 0;
+  }
+  return inuse;
+}
+
+#ifdef SINGLE
+#define PLAN_FFTW_FOR_NUFFT plan_fftw_for_nufftf
+#define EXECUTE_FFTW execute_fftwf
+#else
+#define PLAN_FFTW_FOR_NUFFT plan_fftw_for_nufft
+#define EXECUTE_FFTW execute_fftw
+#endif
+
+// FFTW's global planner thread count, as set at FFTW init in makeplan...
+static int fftwPlanNthr = 1;
+
+void PLAN_FFTW_FOR_NUFFT(FINUFFT_PLAN p, int nthr_fft)
+/* (Re)plans the t1,2 FFT of the batch of fine grids p->fwBatch (from
+   p->fwPadBatch if present), as one multidimensional FFTW plan, or as pruned
+   1D passes if opts.fftw_prune (2D/3D, not zeropad_once), for nthr_fft
+   threads. If p->remBatchSize>0, the same is planned for that many grids,
+   for the short last batch. All planning is done inside makeplan's FFTW
+   init lock (OMP critical). If batches are pipelined (p->nthrPipeFFT>0),
+   FFTW's global planner thread count is set to nthr_fft in there for this
+   planning, then set back; otherwise the global count set at init is used.
+   With FFTW_MEASURE this overwrites the contents of fwBatch. With
+   opts.plan_cache, plans are taken from the process-wide cache if there,
+   else made and added to it (keyed on the thread count actually used).
+*/
+{
+  CNTime timer; timer.start();
+  DESTROY_FFTW_PLANS(p);                    // in case of replanning
+  int dim = p->dim;
+  bool padonce = (p->fwPadBatch != NULL);
+  bool setthr = (p->nthrPipeFFT>0);
+  int nthr_plan = setthr ? nthr_fft : fftwPlanNthr;   // what FFTW will use
+  int *ns = GRIDSIZE_FOR_FFTW(p);
+  int *embed = NULL;          // with ghosts, FFT the interior of each array
+  if (p->spopts.ghost) {
+    embed = new int[dim];
+    for (int d=0; d<dim; ++d)
+      embed[d] = ns[d] + 2*p->spopts.ghost;
+  }
+  FFTW_CPX *fw0 = p->fwBatch + p->fwoff;    // first grid's pt (0,0,0)
+  BIGINT gdims[3];
+  ghost_dims(gdims, p->nf1, p->nf2, p->nf3, p->spopts.ghost);
+  bool prune = p->opts.fftw_prune && dim>1 && !padonce;
+  auto plan = [&](int howmany, FFTW_PLAN *passes) -> FFTW_PLAN {
+    // grids are embed (NULL: ns) sized arrays, nfw apart (nf if unpadded)
+    if (prune) {       // 1D passes, needed lines
+      p->nfftwPasses = PLAN_FFTW_PASSES(p, fw0, gdims, howmany, passes);
+      return NULL;
+    } else if (padonce)  // out-of-place, from the plain padded grids (kept)
+      return FFTW_PLAN_MANY_DFT(dim, ns, howmany, p->fwPadBatch,
+         NULL, 1, p->nf, fw0, embed, 1, p->nfw, p->fftSign,
+         p->opts.fftw | FFTW_PRESERVE_INPUT);
+    else
+      return FFTW_PLAN_MANY_DFT(dim, ns, howmany, fw0,
+         embed, 1, p->nfw, fw0, embed, 1, p->nfw, p->fftSign, p->opts.fftw);
+  };
+  // with opts.plan_cache, look for the same FFT in the cache, else add it...
+  auto cached = [&](int howmany, FFTW_PLAN *passes) -> FFTW_PLAN {
+    if (!p->opts.plan_cache)
+      return plan(howmany, passes);
+    BIGINT key[FFTW_CACHE_NKEY] = {p->nf1, p->nf2, p->nf3, howmany,
+      p->fftSign, p->opts.fftw, nthr_plan, p->spopts.ghost, padonce, prune,
+      // pruned passes depend on type (pass order) and the modes...
+      prune ? p->type : 0, prune ? p->ms : 0, prune ? p->mt : 0,
+      prune ? p->mu : 0, dim};
+    FFTW_PLAN f = NULL;
+    bool hit = false;
+#pragma omp critical (finufft_plan_cache)
+    {
+      for (auto &e : planCache.fftw)
+        if (std::equal(key, key+FFTW_CACHE_NKEY, e.key)) {
+          f = e.plan;
+          p->nfftwPasses = e.npasses;
+          for (int i=0; i<e.npasses; ++i) {
+            passes[i] = e.passes[i];
+            p->fftwPassOff[i] = e.passOff[i];
+          }
+          ++e.refs;
+          e.lastuse = ++planCache.clock;
+          ++planCache.hits[0];
+          hit = true;
+          break;
+        }
+      if (!hit) {
+        f = plan(howmany, passes);
+        FFTW_CACHE_ENTRY e;
+        std::copy(key, key+FFTW_CACHE_NKEY, e.key);
+        e.plan = f;
+        e.npasses = p->nfftwPasses;
+        for (int i=0; i<e.npasses; ++i) {
+          e.passes[i] = passes[i];
+          e.passOff[i] = p->fftwPassOff[i];
+        }
+        e.refs = 1;
+        e.lastuse = ++planCache.clock;
+        planCache.fftw.push_back(e);
+        ++planCache.misses[0];
+        evict_unused(planCache.fftw, PLAN_CACHE_MAX, destroy_fftw_entry);
+      }
+    }
+    return f;
+  };
+  // all planning is in the FFTW init lock, so no other plan sees our count
+#pragma omp critical
+  {
+    if (setthr) FFTW_PLAN_TH(nthr_fft);
+    p->fftwPlan = cached(p->batchSize, p->fftwPasses);
+    if (p->remBatchSize)
+      p->fftwPlanRem = cached(p->remBatchSize, p->fftwRemPasses);
+    if (setthr) FFTW_PLAN_TH(fftwPlanNthr);
+  }
+  if (p->opts.debug) printf("[%s] FFTW plan (mode %d, nthr=%d, %d passes, last batch %d):\t%.3g s\n", __func__,p->opts.fftw, nthr_plan, max(1,p->nfftwPasses), p->remBatchSize ? p->remBatchSize : p->batchSize, timer.elapsedsec());
+  delete []ns;
+  delete []embed;
+}
+
+void EXECUTE_FFTW(FINUFFT_PLAN p, FFTW_CPX *fw, int thisBatchSize)
+/* Runs the planned t1,2 FFT on the batch of thisBatchSize fine grids fw:
+   p->fwBatch, as planned, or p->fwBatch2 (batch_pipeline), which has the
+   same alignment so that FFTW's new-array execute applies (as it does to
+   plans from the opts.plan_cache cache). A short last batch
+   (p->remBatchSize) uses its own exact-size plans.
+*/
+{
+  FFTW_CPX *fw0 = fw + p->fwoff;            // first grid's pt (0,0,0)
+  bool rem = (p->remBatchSize && thisBatchSize==p->remBatchSize);
+  FFTW_PLAN *passes = rem ? p->fftwRemPasses : p->fftwPasses;
+  FFTW_PLAN plan = rem ? p->fftwPlanRem : p->fftwPlan;
+  if (p->nfftwPasses)        // pruned (opts.fftw_prune)
+    for (int i=0; i<p->nfftwPasses; ++i)
+      FFTW_EX_DFT(passes[i], fw0 + p->fftwPassOff[i], fw0 + p->fftwPassOff[i]);
+  else if (fw==p->fwBatch && !p->opts.plan_cache)
+    FFTW_EX(plan);
+  else            // (a cached plan may have been planned on another fwBatch)
+    FFTW_EX_DFT(plan, p->fwPadBatch ? p->fwPadBatch : fw0, fw0);
+}
+
+#ifdef SINGLE
+#define EXECUTE_BATCH execute_batchf
+#else
+#define EXECUTE_BATCH execute_batch
+#endif
+
+void EXECUTE_BATCH(FINUFFT_PLAN p, int thisBatchSize, CPX* cjb, CPX* fkb,
+                   double *t)
+/* Types 1,2: does the three steps of execute for one batch of thisBatchSize
+   (<= batchSize) vectors in cjb (NU side) and fkb (modes), on all threads,
+   adding their times to t[0] (spread/interp), t[1] (FFT), t[2] (deconvolve).
+   Also used by type 3 for its inner type 2 plan, batch by batch.
+*/
+{
+  CNTime timer; timer.start();
+  // STEP 1: (varies by type)
+  if (p->type == 1) {  // type 1: spread NU pts p->X, weights cj, to fw grid
+    spreadinterpSortedBatch(thisBatchSize, p, cjb, p->fwBatch, p->opts.nthreads);
+    t[0] += timer.elapsedsec();
+  } else {          //  type 2: amplify Fourier coeffs fk into 0-padded fw
+    deconvolveBatch(thisBatchSize, p, fkb, p->fwBatch, p->opts.nthreads);
+    t[2] += timer.elapsedsec();
+  }
+
+  // STEP 2: call the pre-planned FFT on this batch (exact size if last)
+  timer.restart();
+  EXECUTE_FFTW(p, p->fwBatch, thisBatchSize);
+  t[1] += timer.elapsedsec();
+  if (p->opts.debug>1)
+    printf("\tFFTW exec:\t\t%.3g s\n", timer.elapsedsec());
+
+  // STEP 3: (varies by type)
+  timer.restart();
+  if (p->type == 1) {   // type 1: deconvolve (amplify) fw and shuffle to fk
+    deconvolveBatch(thisBatchSize, p, fkb, p->fwBatch, p->opts.nthreads);
+    t[2] += timer.elapsedsec();
+  } else {          // type 2: interpolate unif fw grid to NU target pts
+    spreadinterpSortedBatch(thisBatchSize, p, cjb, p->fwBatch, p->opts.nthreads);
+    t[0] += timer.elapsedsec();
+  }
+}
+
+#ifdef SINGLE
+#define EXECUTE_PIPELINED execute_pipelinedf
+#else
+#define EXECUTE_PIPELINED execute_pipelined
+#endif
+
+int EXECUTE_PIPELINED(FINUFFT_PLAN p, CPX* cj, CPX* fk)
+/* Types 1,2 execute with opts.batch_pipeline (p->nthrPipeFFT>0, >1 batch).
+   Batches alternate between the fine grid buffers p->fwBatch and fwBatch2,
+   so that two batches are in flight, each stage on its own thread group:
+   the NU side (spread or interp) on opts.nthreads-nthrPipeFFT threads, and
+   the grid side (deconvolve and FFT) on the nthrPipeFFT threads FFTW was
+   planned for. So for t1, batch b is spread while batch b-1 is FFTed and
+   deconvolved; for t2, batch b is deconvolved and FFTed while batch b-1 is
+   interpolated. Spreading is latency-bound and FFTW bandwidth-bound, so they
+   share the machine better than either alone.
+   Afterwards a thread split is re-tuned, to balance the two stages' work
+   measured in the overlapped steps (assuming each scales linearly with
+   threads), and recorded in p->nthrPipeTuned if that gains over 10%. It is
+   applied (replanning FFTW) by the next setpts, not here, so that execute
+   never plans. Returns 0.
+*/
+{
+  CNTime timer; timer.start();
+  int nthr = p->opts.nthreads, nb = p->nbatch, type = p->type;
+  int ngrid = p->nthrPipeFFT, nnu = nthr - ngrid;
+  if (p->opts.debug)
+    printf("[%s] start ntrans=%d (%d batches, bsize=%d, pipelined on %d+%d thr)...\n", __func__, p->ntrans, nb, p->batchSize, nnu, ngrid);
+  auto bsize = [&](int b) { return min(p->ntrans - b*p->batchSize, p->batchSize); };
+  auto fwb = [&](int b) { return (b%2) ? p->fwBatch2 : p->fwBatch; };
+  auto nuside = [&](int b, int nt) {           // spread or interp of batch b
+    spreadinterpSortedBatch(bsize(b), p, cj + (BIGINT)b*p->batchSize*p->nj,
+                            fwb(b), nt); };
+  auto gridside = [&](int b, int nt) {         // deconvolve & FFT of batch b
+    CPX *fkb = fk + (BIGINT)b*p->batchSize*p->N;
+    if (type==2) deconvolveBatch(bsize(b), p, fkb, fwb(b), nt);
+    EXECUTE_FFTW(p, fwb(b), bsize(b));
+    if (type==1) deconvolveBatch(bsize(b), p, fkb, fwb(b), nt); };
+
+  // fill the pipeline: 1st stage of batch 0 alone, on all threads
+  if (type==1) nuside(0, nthr); else gridside(0, nthr);
+  double t_fill = timer.elapsedsec(), t_nu = 0.0, t_grid = 0.0;
+  int levels = MY_OMP_GET_MAX_ACTIVE_LEVELS();   // the stages nest OMP
+  MY_OMP_SET_MAX_ACTIVE_LEVELS(max(levels,2));
+  for (int b=1; b<nb; b++) {     // 2nd stage of batch b-1 with 1st of b
+#pragma omp parallel num_threads(2)
+    {
+      CNTime t; t.start();
+      if (MY_OMP_GET_THREAD_NUM()==0) {
+        nuside(type==1 ? b : b-1, nnu);
+        t_nu += t.elapsedsec();
+      } else {
+        gridside(type==1 ? b-1 : b, ngrid);
+        t_grid += t.elapsedsec();
+      }
+    }
+  }
+  MY_OMP_SET_MAX_ACTIVE_LEVELS(levels);
+  timer.restart();               // drain: 2nd stage of last batch alone
+  if (type==1) gridside(nb-1, nthr); else nuside(nb-1, nthr);
+  double t_drain = timer.elapsedsec();
+
+  // re-tune split: the balanced one has ngrid/nnu = (grid work)/(NU work)
+  double wnu = t_nu*nnu, wgrid = t_grid*ngrid;
+  int ng = (int)round(nthr*wgrid/(wnu+wgrid+1e-300));
+  ng = min(nthr-1, max(1, ng));
+  double tnow = max(t_nu,t_grid)/(nb-1);            // per overlapped step
+  double tnew = max(wnu/(nthr-ng), wgrid/ng)/(nb-1);
+  if (p->opts.debug) {
+    printf("[%s] done. fill:\t\t\t%.3g s\n", __func__, t_fill);
+    printf("               tot %s:\t\t\t%.3g s\n", type==1 ? "spread" : "interp", t_nu);
+    printf("               tot %s:\t\t%.3g s\n", type==1 ? "FFT+deconvolve" : "deconvolve+FFT", t_grid);
+    printf("               drain:\t\t\t\t%.3g s\n", t_drain);
+    printf("               split %d+%d thr: predicted step %.3g s (now %.3g s)\n", nthr-ng, ng, tnew, tnow);
+  }
+  if (ng!=ngrid && tnew < 0.9*tnow)
+    p->nthrPipeTuned = ng;         // for the next setpts
+  return 0;
+}
+
+
 
 
 // --------------- rest is the 5 user guru (plan) interface drivers: -----------
@@ -528,6 +1197,24 @@ void FINUFFT_DEFAULT_OPTS(nufft_opts *o)
   o->maxbatchsize = 0;
   o->spread_nthr_atomic = -1;
   o->spread_max_sp_size = 0;
+  o->spread_method = 0;
+  o->spread_kercache = 0;
+  o->spread_kercache_mb = 2000;
+  o->spread_copypts = 0;
+  o->spread_sortedio = 0;
+  o->spread_ghost = 0;
+  o->spread_balance = 0;
+  o->zeropad_once = 0;
+  o->numa = 0;
+  o->hugepages = 0;
+  o->spread_interp_method = 0;
+  o->spread_binsize_x = 0;
+  o->spread_binsize_y = 0;
+  o->spread_binsize_z = 0;
+  o->spread_binorder = 0;
+  o->fftw_prune = 0;
+  o->batch_pipeline = 0;
+  o->plan_cache = 0;
   // sphinx tag (don't remove): @defopts_end
 }
 
@@ -589,12 +1276,19 @@ int FINUFFT_MAKEPLAN(int type, int dim, BIGINT* n_modes, int iflag,
     p->batchSize = min(p->opts.maxbatchsize,ntrans);
     p->nbatch = 1+(ntrans-1)/p->batchSize;  // resulting # batches
   }
+  // (auto batches are as even as possible, but a short last one may remain;
+  // t1,2 then plan an exact-size FFT for it)
+  p->remBatchSize = ntrans % p->batchSize;
   if (p->opts.spread_thread==0)
     p->opts.spread_thread=2;                // our auto choice
-  if (p->opts.spread_thread!=1 && p->opts.spread_thread!=2) {
+  if (p->opts.spread_thread<1 || p->opts.spread_thread>3) {
     fprintf(stderr,"[%s] illegal opts.spread_thread!\n",__func__);
     return ERR_SPREAD_THREAD_NOTVALID;
   }
+  if (p->opts.spread_method<0 || p->opts.spread_method>3) {
+    fprintf(stderr,"[%s] illegal opts.spread_method!\n",__func__);
+    return ERR_SPREAD_METHOD_NOTVALID;
+  }
 
   if (type!=3) {    // read in user Fourier mode array sizes...
     p->ms = n_modes[0];
@@ -622,9 +1316,17 @@ int FINUFFT_MAKEPLAN(int type, int dim, BIGINT* n_modes, int iflag,
 
   // set others as defaults (or unallocated for arrays)...
   p->X = NULL; p->Y = NULL; p->Z = NULL;
-  p->phiHat1 = NULL; p->phiHat2 = NULL; p->phiHat3 = NULL;
+  p->phiHatInv1 = NULL; p->phiHatInv2 = NULL; p->phiHatInv3 = NULL;
   p->nf1 = 1; p->nf2 = 1; p->nf3 = 1;  // crucial to leave as 1 for unused dims
   p->sortIndices = NULL;               // used in all three types
+  p->sortIdx32 = false;
+  p->fftwPlan = NULL;
+  p->fftwPlanRem = NULL;
+  p->nfftwPasses = 0;
+  p->nthrPipeFFT = 0;
+  p->nthrPipeTuned = 0;
+  p->spreadPlan = NULL;                // used in types 1 and 3 (and 2, if opted)
+  p->kerCache = NULL;                  // used in all three types, if opted
   
   //  ------------------------ types 1,2: planning needed ---------------------
   if (type==1 || type==2) {
@@ -639,12 +1341,16 @@ int FINUFFT_MAKEPLAN(int type, int dim, BIGINT* n_modes, int iflag,
       if (!did_fftw_init) {
 	FFTW_INIT();            // setup FFTW global state; should only do once
 	FFTW_PLAN_TH(nthr_fft); // ditto
+	fftwPlanNthr = nthr_fft;  // restored after any pipelined planning
 	FFTW_PLAN_SF();         // if -DFFTW_PLAN_SAFE, make FFTW thread-safe
 	did_fftw_init = 1;      // insure other FINUFFT threads don't clash
       }
     } 
 
     p->spopts.spread_direction = type;
+    p->spopts.sorted_io = p->opts.spread_sortedio;   // (c in sorted order?)
+    // ghost pts per side to hold all kernel stencils (ns/2 below, ceil above)
+    p->spopts.ghost = p->opts.spread_ghost ? (p->spopts.nspread+1)/2 : 0;
 
     if (p->opts.showwarn) {  // user warn round-off error...
       if (EPSILON*p->ms>1.0)
@@ -658,16 +1364,13 @@ int FINUFFT_MAKEPLAN(int type, int dim, BIGINT* n_modes, int iflag,
     // determine fine grid sizes, sanity check..
     int nfier = SET_NF_TYPE12(p->ms, p->opts, p->spopts, &(p->nf1));
     if (nfier) return nfier;    // nf too big; we're done
-    p->phiHat1 = (FLT*)malloc(sizeof(FLT)*(p->nf1/2 + 1));
     if (dim > 1) {
       nfier = SET_NF_TYPE12(p->mt, p->opts, p->spopts, &(p->nf2));
       if (nfier) return nfier;
-      p->phiHat2 = (FLT*)malloc(sizeof(FLT)*(p->nf2/2 + 1));
     }
     if (dim > 2) {
       nfier = SET_NF_TYPE12(p->mu, p->opts, p->spopts, &(p->nf3)); 
       if (nfier) return nfier;
-      p->phiHat3 = (FLT*)malloc(sizeof(FLT)*(p->nf3/2 + 1));
     }
 
     if (p->opts.debug) { // "long long" here is to avoid warnings with printf...
@@ -683,32 +1386,54 @@ int FINUFFT_MAKEPLAN(int type, int dim, BIGINT* n_modes, int iflag,
 
     // STEP 0: get Fourier coeffs of spreading kernel along each fine grid dim
     CNTime timer; timer.start();
-    onedim_fseries_kernel(p->nf1, p->phiHat1, p->spopts);
-    if (dim>1) onedim_fseries_kernel(p->nf2, p->phiHat2, p->spopts);
-    if (dim>2) onedim_fseries_kernel(p->nf3, p->phiHat3, p->spopts);
+    // (stored as reciprocals; with opts.plan_cache maybe shared)
+    p->phiHatInv1 = PHIHATINV_FOR_NUFFT(p, p->nf1);
+    if (dim>1) p->phiHatInv2 = PHIHATINV_FOR_NUFFT(p, p->nf2);
+    if (dim>2) p->phiHatInv3 = PHIHATINV_FOR_NUFFT(p, p->nf3);
     if (p->opts.debug) printf("[%s] kernel fser (ns=%d):\t\t%.3g s\n",__func__,p->spopts.nspread, timer.elapsedsec());
 
     timer.restart();
     p->nf = p->nf1*p->nf2*p->nf3;      // fine grid total number of points
-    if (p->nf * p->batchSize > MAX_NF) {
+    BIGINT gdims[3];                   // fine grid array sizes, incl ghosts
+    p->fwoff = ghost_dims(gdims, p->nf1, p->nf2, p->nf3, p->spopts.ghost);
+    p->nfw = gdims[0]*gdims[1]*gdims[2];
+    bool padonce = (type==2 && p->opts.zeropad_once);  // separate FFT input?
+    // pipelined batches need a 2nd buffer, the FFT input (not with padonce)
+    bool pipe = p->opts.batch_pipeline && p->nbatch>1 && nthr>1 && !padonce;
+    if (p->opts.batch_pipeline && !pipe && p->opts.debug)
+      printf("[%s] batch_pipeline ignored (%s)\n", __func__, padonce ? "zeropad_once" : "1 batch or 1 thread");
+    p->nthrPipeFFT = pipe ? max(1, nthr/2) : 0;    // re-tuned by execute
+    // 2nd buffer offset (if pipe) a multiple of 8 pts keeps FFTW alignment
+    BIGINT nfwBatch = pipe ? 2*(((p->nfw*p->batchSize + 7)/8)*8) : p->nfw*p->batchSize;
+    if (nfwBatch + (padonce ? p->nf*p->batchSize : 0) > MAX_NF) {
       fprintf(stderr, "[%s] fwBatch would be bigger than MAX_NF, not attempting malloc!\n",__func__);
       return ERR_MAXNALLOC;
     }
-    p->fwBatch = FFTW_ALLOC_CPX(p->nf * p->batchSize);    // the big workspace
-    if (p->opts.debug) printf("[%s] fwBatch %.2fGB alloc:   \t%.3g s\n", __func__,(double)1E-09*sizeof(CPX)*p->nf*p->batchSize, timer.elapsedsec());
-    if(!p->fwBatch) {      // we don't catch all such mallocs, just this big one
+    p->fwBatch = FFTW_ALLOC_CPX(nfwBatch);   // the big workspace
+    p->fwBatch2 = (pipe && p->fwBatch) ? p->fwBatch + nfwBatch/2 : NULL;
+    p->fwPadBatch = padonce ? FFTW_ALLOC_CPX(p->nf * p->batchSize) : NULL;
+    if (p->opts.debug) printf("[%s] fwBatch %.2fGB alloc:   \t%.3g s\n", __func__,(double)1E-09*sizeof(CPX)*nfwBatch, timer.elapsedsec());
+    if(!p->fwBatch || (padonce && !p->fwPadBatch)) {      // we don't catch all such mallocs, just this big one
       fprintf(stderr, "[%s] FFTW malloc failed for fwBatch (working fine grids)!\n",__func__);
-      free(p->phiHat1); free(p->phiHat2); free(p->phiHat3);
+      FFTW_FR(p->fwBatch); FFTW_FR(p->fwPadBatch);
+      FREE_PHIHATINV(p, p->phiHatInv1); FREE_PHIHATINV(p, p->phiHatInv2);
+      FREE_PHIHATINV(p, p->phiHatInv3);
       return ERR_ALLOC;
     }
+    ADVISE_HUGEPAGES(p, p->fwBatch, sizeof(FFTW_CPX)*nfwBatch, "fwBatch");
+    ADVISE_HUGEPAGES(p, p->fwPadBatch, sizeof(FFTW_CPX)*p->nf*p->batchSize, "fwPadBatch");
+    PLACE_FINE_GRIDS(p, p->fwBatch, p->nfw, p->batchSize, false);
+    if (pipe)
+      PLACE_FINE_GRIDS(p, p->fwBatch2, p->nfw, p->batchSize, false);
+    if (padonce) {         // its zero padding then stays for all executes
+      timer.restart();
+      PLACE_FINE_GRIDS(p, p->fwPadBatch, p->nf, p->batchSize, true);
+      if (p->opts.debug) printf("[%s] fwPadBatch %.2fGB alloc, zero:\t%.3g s\n", __func__,(double)1E-09*sizeof(CPX)*p->nf*p->batchSize, timer.elapsedsec());
+    }
    
-    timer.restart();            // plan the FFTW
-    int *ns = GRIDSIZE_FOR_FFTW(p);
-    // fftw_plan_many_dft args: rank, gridsize/dim, howmany, in, inembed, istride, idist, ot, onembed, ostride, odist, sign, flags 
-    p->fftwPlan = FFTW_PLAN_MANY_DFT(dim, ns, p->batchSize, p->fwBatch,
-         NULL, 1, p->nf, p->fwBatch, NULL, 1, p->nf, p->fftSign, p->opts.fftw);
-    if (p->opts.debug) printf("[%s] FFTW plan (mode %d, nthr=%d):\t%.3g s\n", __func__,p->opts.fftw, nthr_fft, timer.elapsedsec());
-    delete []ns;
+    if (p->opts.fftw_prune && (dim==1 || padonce) && p->opts.debug)
+      printf("[%s] fftw_prune ignored (%s)\n", __func__, dim==1 ? "1D" : "zeropad_once");
+    PLAN_FFTW_FOR_NUFFT(p, p->nthrPipeFFT ? p->nthrPipeFFT : nthr_fft);
     
   } else {  // -------------------------- type 3 (no planning) ------------
 
@@ -716,6 +1441,8 @@ int FINUFFT_MAKEPLAN(int type, int dim, BIGINT* n_modes, int iflag,
     // in case destroy occurs before setpts, need safe dummy ptrs/plans...
     p->CpBatch = NULL;
     p->fwBatch = NULL;
+    p->fwBatch2 = NULL;
+    p->fwPadBatch = NULL;
     p->Sp = NULL; p->Tp = NULL; p->Up = NULL;
     p->prephase = NULL;
     p->deconv = NULL;
@@ -742,22 +1469,64 @@ int FINUFFT_SETPTS(FINUFFT_PLAN p, BIGINT nj, FLT* xj, FLT* yj, FLT* zj,
 
   if (p->type!=3) {  // ------------------ TYPE 1,2 SETPTS -------------------
                      // (all we can do is check and maybe bin-sort the NU pts)
-    p->X = xj;       // plan must keep pointers to user's fixed NU pts
-    p->Y = yj;
-    p->Z = zj;
+    if (p->opts.spread_copypts) {  // in case of repeated setpts
+      free(p->X); free(p->Y); free(p->Z);
+      p->X = NULL; p->Y = NULL; p->Z = NULL;
+    }
+    p->spopts.sorted_pts = 0;
     int ier = spreadcheck(p->nf1, p->nf2, p->nf3, p->nj, xj, yj, zj, p->spopts);
     if (p->opts.debug>1) printf("[%s] spreadcheck (%d):\t%.3g s\n", __func__, p->spopts.chkbnds, timer.elapsedsec());
     if (ier)         // no warnings allowed here
       return ier;    
     timer.restart();
-    p->sortIndices = (BIGINT *)malloc(sizeof(BIGINT)*p->nj);
-    if (!p->sortIndices) {
-      fprintf(stderr,"[%s] failed to allocate sortIndices!\n",__func__);
-      return ERR_SPREAD_ALLOC;
+    ier = SORT_NU_PTS(p, xj, yj, zj);
+    if (ier) return ier;
+    if (p->opts.debug) printf("[%s] sort (didSort=%d, %d-bit idx):\t%.3g s\n", __func__,p->didSort, p->sortIdx32 ? 32 : 64, timer.elapsedsec());
+
+    if (p->nthrPipeTuned && p->nthrPipeTuned!=p->nthrPipeFFT) {
+      p->nthrPipeFFT = p->nthrPipeTuned;  // batch_pipeline split from execute
+      PLAN_FFTW_FOR_NUFFT(p, p->nthrPipeFFT);
     }
-    p->didSort = indexSort(p->sortIndices, p->nf1, p->nf2, p->nf3, p->nj, xj, yj, zj, p->spopts);
-    if (p->opts.debug) printf("[%s] sort (didSort=%d):\t\t%.3g s\n", __func__,p->didSort, timer.elapsedsec());
 
+    if (p->opts.spread_copypts) {  // folded pts in sorted order, owned by plan
+      timer.restart();
+      p->X = (FLT*)malloc(sizeof(FLT)*nj);
+      if (d>1) p->Y = (FLT*)malloc(sizeof(FLT)*nj);
+      if (d>2) p->Z = (FLT*)malloc(sizeof(FLT)*nj);
+      if (nj>0 && (!p->X || (d>1 && !p->Y) || (d>2 && !p->Z))) {
+        fprintf(stderr,"[%s] failed to allocate sorted NU pt copies!\n",__func__);
+        free(p->X); free(p->Y); free(p->Z);
+        p->X = NULL; p->Y = NULL; p->Z = NULL;
+        return ERR_SPREAD_ALLOC;
+      }
+      ADVISE_HUGEPAGES(p, p->X, sizeof(FLT)*nj, "X");
+      ADVISE_HUGEPAGES(p, p->Y, sizeof(FLT)*nj, "Y");
+      ADVISE_HUGEPAGES(p, p->Z, sizeof(FLT)*nj, "Z");
+      with_sort_indices(p, [&](auto si) {
+          fold_sorted_pts(p->X, p->Y, p->Z, si, p->nf1, p->nf2, p->nf3, p->nj,
+                          xj, yj, zj, p->spopts);
+          return 0; });
+      p->spopts.sorted_pts = 1;
+      if (p->opts.debug) printf("[%s] copy sorted pts:\t\t%.3g s\n", __func__, timer.elapsedsec());
+    } else {
+      p->X = xj;     // plan must keep pointers to user's fixed NU pts
+      p->Y = yj;
+      p->Z = zj;
+    }
+
+    if (p->type==1 || (p->opts.spread_interp_method==1 && p->didSort)) {
+      // plan subproblems & arena (t2: interp subgrids), reused by all execs
+      timer.restart();
+      ier = SETUP_SPREAD_PLAN_FOR_NUFFT(p);
+      if (ier) return ier;
+      if (p->opts.debug) printf("[%s] spread plan:\t\t%.3g s\n", __func__, timer.elapsedsec());
+    }
+    if (p->opts.spread_kercache) {   // kernel vals, reused by all execs
+      timer.restart();
+      ier = SETUP_KER_CACHE_FOR_NUFFT(p);
+      if (ier) return ier;
+      if (p->opts.debug) printf("[%s] kernel cache (%d):\t\t%.3g s\n", __func__, p->kerCache!=NULL, timer.elapsedsec());
+    }
     
   } else {   // ------------------------- TYPE 3 SETPTS -----------------------
              // (here we can precompute pre/post-phase factors and plan the t2)
@@ -799,6 +1568,8 @@ int FINUFFT_SETPTS(FINUFFT_PLAN p, BIGINT nj, FLT* xj, FLT* yj, FLT* zj,
         printf("\tX3=%.3g C3=%.3g S3=%.3g D3=%.3g gam3=%g nf3=%lld\n", p->t3P.X3, p->t3P.C3,S3, p->t3P.D3, p->t3P.gam3,(long long) p->nf3);
     }
     p->nf = p->nf1*p->nf2*p->nf3;      // fine grid total number of points
+    p->nfw = p->nf;                    // (t3 fine grids have no ghost pts)
+    p->fwoff = 0;
     if (p->nf * p->batchSize > MAX_NF) {
       fprintf(stderr, "[%s t3] fwBatch would be bigger than MAX_NF, not attempting malloc!\n",__func__);
       return ERR_MAXNALLOC;
@@ -811,6 +1582,9 @@ int FINUFFT_SETPTS(FINUFFT_PLAN p, BIGINT nj, FLT* xj, FLT* yj, FLT* zj,
       fprintf(stderr, "[%s t3] malloc fail for fwBatch or CpBatch!\n",__func__);
       return ERR_ALLOC; 
     }
+    ADVISE_HUGEPAGES(p, p->fwBatch, sizeof(FFTW_CPX)*p->nf*p->batchSize, "fwBatch");
+    ADVISE_HUGEPAGES(p, p->CpBatch, sizeof(CPX)*nj*p->batchSize, "CpBatch");
+    PLACE_FINE_GRIDS(p, p->fwBatch, p->nf, p->batchSize, false);
     //printf("fwbatch, cpbatch ptrs: %llx %llx\n",p->fwBatch,p->CpBatch);
 
     // alloc rescaled NU src pts x'_j (in X etc), rescaled NU targ pts s'_k ...
@@ -824,6 +1598,12 @@ int FINUFFT_SETPTS(FINUFFT_PLAN p, BIGINT nj, FLT* xj, FLT* yj, FLT* zj,
       p->Z = (FLT*)malloc(sizeof(FLT)*nj);
       p->Up = (FLT*)malloc(sizeof(FLT)*nk);
     }
+    ADVISE_HUGEPAGES(p, p->X, sizeof(FLT)*nj, "X'");
+    ADVISE_HUGEPAGES(p, p->Y, sizeof(FLT)*nj, "Y'");
+    ADVISE_HUGEPAGES(p, p->Z, sizeof(FLT)*nj, "Z'");
+    ADVISE_HUGEPAGES(p, p->Sp, sizeof(FLT)*nk, "S'");
+    ADVISE_HUGEPAGES(p, p->Tp, sizeof(FLT)*nk, "T'");
+    ADVISE_HUGEPAGES(p, p->Up, sizeof(FLT)*nk, "U'");
 
     // always shift as use gam to rescale x_j to x'_j, etc (twist iii)...
     FLT ig1 = 1.0/p->t3P.gam1, ig2=0.0, ig3=0.0;   // "reciprocal-math" optim
@@ -905,13 +1685,19 @@ int FINUFFT_SETPTS(FINUFFT_PLAN p, BIGINT nj, FLT* xj, FLT* yj, FLT* zj,
 
     // Set up sort for spreading Cp (from primed NU src pts X, Y, Z) to fw...
     timer.restart();
-    p->sortIndices = (BIGINT *)malloc(sizeof(BIGINT)*p->nj);
-    if (!p->sortIndices) {
-      fprintf(stderr,"[%s t3] failed to allocate sortIndices!\n",__func__);
-      return ERR_SPREAD_ALLOC;
+    int ier = SORT_NU_PTS(p, p->X, p->Y, p->Z);
+    if (ier) return ier;
+    if (p->opts.debug) printf("[%s t3] sort (didSort=%d, %d-bit idx):\t%.3g s\n",__func__, p->didSort, p->sortIdx32 ? 32 : 64, timer.elapsedsec());
+    timer.restart();
+    ier = SETUP_SPREAD_PLAN_FOR_NUFFT(p);   // for spreading Cp to fw
+    if (ier) return ier;
+    if (p->opts.debug) printf("[%s t3] spread plan:\t\t%.3g s\n",__func__, timer.elapsedsec());
+    if (p->opts.spread_kercache) {
+      timer.restart();
+      ier = SETUP_KER_CACHE_FOR_NUFFT(p);
+      if (ier) return ier;
+      if (p->opts.debug) printf("[%s t3] kernel cache (%d):\t%.3g s\n",__func__, p->kerCache!=NULL, timer.elapsedsec());
     }
-    p->didSort = indexSort(p->sortIndices, p->nf1, p->nf2, p->nf3, p->nj, p->X, p->Y, p->Z, p->spopts);
-    if (p->opts.debug) printf("[%s t3] sort (didSort=%d):\t\t%.3g s\n",__func__, p->didSort, timer.elapsedsec());
  
     // Plan and setpts once, for the (repeated) inner type 2 finufft call...
     timer.restart();
@@ -920,9 +1706,12 @@ int FINUFFT_SETPTS(FINUFFT_PLAN p, BIGINT nj, FLT* xj, FLT* yj, FLT* zj,
     t2opts.debug = max(0,p->opts.debug-1);        // don't print as much detail
     t2opts.spread_debug = max(0,p->opts.spread_debug-1);
     t2opts.showwarn = 0;                          // so don't see warnings 2x
+    t2opts.spread_sortedio = 0;                   // its targs are user's order
+    t2opts.maxbatchsize = p->batchSize;  // our batches, incl short last one,
+    t2opts.batch_pipeline = 0;           // are done one at a time by it
     // (...could vary other t2opts here?)
-    int ier = FINUFFT_MAKEPLAN(2, d, t2nmodes, p->fftSign, p->batchSize, p->tol,
-                               &p->innerT2plan, &t2opts);
+    ier = FINUFFT_MAKEPLAN(2, d, t2nmodes, p->fftSign, p->ntrans, p->tol,
+                           &p->innerT2plan, &t2opts);
     if (ier>1) {     // if merely warning, still proceed
       fprintf(stderr,"[%s t3]: inner type 2 plan creation failed with ier=%d!\n",__func__,ier);
       return ier;
@@ -939,6 +1728,25 @@ int FINUFFT_SETPTS(FINUFFT_PLAN p, BIGINT nj, FLT* xj, FLT* yj, FLT* zj,
 }
 // ............ end setpts ..................................................
 
+int FINUFFT_SORTPERM(FINUFFT_PLAN p, BIGINT* perm)
+/* For type 1,2, after setpts: writes to perm (length nj) the plan's order of
+   the NU pts, ie perm[j] is the index (in the user's xj, etc) of the j'th NU pt
+   in the order the spreader visits them. With opts.spread_sortedio=1, c in
+   execute is in this order, ie c[j] belongs to NU pt xj[perm[j]].
+   Returns 0, or ERR_TYPE_NOTVALID for type 3 or if setpts not yet called.
+*/
+{
+  if (p->type==3 || !p->sortIndices) {
+    fprintf(stderr,"[%s] needs a type 1 or 2 plan, after setpts!\n",__func__);
+    return ERR_TYPE_NOTVALID;
+  }
+  with_sort_indices(p, [&](auto si) {
+      for (BIGINT j=0; j<p->nj; ++j)
+        perm[j] = si[j];
+      return 0; });
+  return 0;
+}
+
 
 // EEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEE
 int FINUFFT_EXECUTE(FINUFFT_PLAN p, CPX* cj, CPX* fk){
@@ -957,8 +1765,11 @@ int FINUFFT_EXECUTE(FINUFFT_PLAN p, CPX* cj, CPX* fk){
   CNTime timer; timer.start();
   
   if (p->type!=3){ // --------------------- TYPE 1,2 EXEC ------------------
+
+    if (p->nthrPipeFFT)      // opts.batch_pipeline: stages of 2 batches at once
+      return EXECUTE_PIPELINED(p, cj, fk);
   
-    double t_sprint = 0.0, t_fft = 0.0, t_deconv = 0.0;  // accumulated timing
+    double t[3] = {0.0, 0.0, 0.0};   // accumulated spread/interp, FFT, deconv
     if (p->opts.debug)
       printf("[%s] start ntrans=%d (%d batches, bsize=%d)...\n", __func__, p->ntrans, p->nbatch, p->batchSize);
     
@@ -971,43 +1782,18 @@ int FINUFFT_EXECUTE(FINUFFT_PLAN p, CPX* cj, CPX* fk){
       CPX* fkb = fk + bB*p->N;         // point to batch of mode coeffs
       if (p->opts.debug>1) printf("[%s] start batch %d (size %d):\n",__func__, b,thisBatchSize);
       
-      // STEP 1: (varies by type)
-      timer.restart();
-      if (p->type == 1) {  // type 1: spread NU pts p->X, weights cj, to fw grid
-        spreadinterpSortedBatch(thisBatchSize, p, cjb);
-        t_sprint += timer.elapsedsec();
-      } else {          //  type 2: amplify Fourier coeffs fk into 0-padded fw
-        deconvolveBatch(thisBatchSize, p, fkb);
-        t_deconv += timer.elapsedsec();
-      }
-             
-      // STEP 2: call the pre-planned FFT on this batch
-      timer.restart();
-      FFTW_EX(p->fftwPlan);   // if thisBatchSize<batchSize it wastes some flops
-      t_fft += timer.elapsedsec();
-      if (p->opts.debug>1)
-        printf("\tFFTW exec:\t\t%.3g s\n", timer.elapsedsec());
-      
-      // STEP 3: (varies by type)
-      timer.restart();        
-      if (p->type == 1) {   // type 1: deconvolve (amplify) fw and shuffle to fk
-        deconvolveBatch(thisBatchSize, p, fkb);
-        t_deconv += timer.elapsedsec();
-      } else {          // type 2: interpolate unif fw grid to NU target pts
-        spreadinterpSortedBatch(thisBatchSize, p, cjb);
-        t_sprint += timer.elapsedsec(); 
-      }
+      EXECUTE_BATCH(p, thisBatchSize, cjb, fkb, t);
     }                                                   // ........end b loop
     
     if (p->opts.debug) {  // report total times in their natural order...
       if(p->type == 1) {
-        printf("[%s] done. tot spread:\t\t%.3g s\n",__func__,t_sprint);
-        printf("               tot FFT:\t\t\t\t%.3g s\n", t_fft);
-        printf("               tot deconvolve:\t\t\t%.3g s\n", t_deconv);
+        printf("[%s] done. tot spread:\t\t%.3g s\n",__func__,t[0]);
+        printf("               tot FFT:\t\t\t\t%.3g s\n", t[1]);
+        printf("               tot deconvolve:\t\t\t%.3g s\n", t[2]);
       } else {
-        printf("[%s] done. tot deconvolve:\t\t%.3g s\n",__func__,t_deconv);
-        printf("               tot FFT:\t\t\t\t%.3g s\n", t_fft);
-        printf("               tot interp:\t\t\t%.3g s\n",t_sprint);
+        printf("[%s] done. tot deconvolve:\t\t%.3g s\n",__func__,t[2]);
+        printf("               tot FFT:\t\t\t\t%.3g s\n", t[1]);
+        printf("               tot interp:\t\t\t%.3g s\n",t[0]);
       }
     }
   }
@@ -1042,18 +1828,17 @@ int FINUFFT_EXECUTE(FINUFFT_PLAN p, CPX* cj, CPX* fk){
       // STEP 1: spread c'_j batch (x'_j NU pts) into fw batch grid...
       timer.restart();
       p->spopts.spread_direction = 1;                         // spread
-      spreadinterpSortedBatch(thisBatchSize, p, p->CpBatch);  // p->X are primed
+      spreadinterpSortedBatch(thisBatchSize, p, p->CpBatch, p->fwBatch,
+                              p->opts.nthreads);       // p->X are primed
       t_spr += timer.elapsedsec();
 
       //for (int j=0;j<p->nf1;++j) printf("fw[%d]=%.3g+%.3gi\n",j,p->fwBatch[j][0],p->fwBatch[j][1]);  // debug
    
       // STEP 2: type 2 NUFFT from fw batch to user output fk array batch...
       timer.restart();
-      // illegal possible shrink of ntrans *after* plan for smaller last batch:
-      p->innerT2plan->ntrans = thisBatchSize;      // do not try this at home!
-      /* (alarming that FFTW not shrunk, but safe, because t2's fwBatch array
-         still the same size, as Andrea explained; just wastes a few flops) */
-      FINUFFT_EXECUTE(p->innerT2plan, fkb, (CPX*)(p->fwBatch));
+      // (inner plan has our ntrans & batchSize, so our last batch is its last)
+      double t2t[3] = {0.0, 0.0, 0.0};
+      EXECUTE_BATCH(p->innerT2plan, thisBatchSize, fkb, (CPX*)(p->fwBatch), t2t);
       t_t2 += timer.elapsedsec();
 
       // STEP 3: apply deconvolve (precomputed 1/phiHat(targ_k), phasing too)...
@@ -1090,12 +1875,18 @@ int FINUFFT_DESTROY(FINUFFT_PLAN p)
   if (!p)                // NULL ptr, so not a ptr to a plan, report error
     return 1;
   FFTW_FR(p->fwBatch);   // free the big FFTW (or t3 spread) working array
+  FFTW_FR(p->fwPadBatch);   // (t2 zeropad_once only, else NULL)
   free(p->sortIndices);
+  destroy_spread_plan(p->spreadPlan);
+  destroy_ker_cache(p->kerCache);
   if (p->type==1 || p->type==2) {
-    FFTW_DE(p->fftwPlan);
-    free(p->phiHat1);
-    free(p->phiHat2);
-    free(p->phiHat3);
+    DESTROY_FFTW_PLANS(p);             // (or release them to the cache)
+    if (p->opts.spread_copypts) {      // else they are the user's NU pts
+      free(p->X); free(p->Y); free(p->Z);
+    }
+    FREE_PHIHATINV(p, p->phiHatInv1);
+    FREE_PHIHATINV(p, p->phiHatInv2);
+    FREE_PHIHATINV(p, p->phiHatInv3);
   } else {               // free the stuff alloc for type 3 only
     FINUFFT_DESTROY(p->innerT2plan);   // if NULL, ignore its error code
     free(p->CpBatch);
@@ -3,43 +3,84 @@
 #include <defs.h>
 #include <utils.h>
 #include <utils_precindep.h>
+#include <simd.h>
 
 #include <stdlib.h>
 #include <vector>
+#include <algorithm>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 using namespace std;
 
 // declarations of purely internal functions...
-static inline void set_kernel_args(FLT *args, FLT x, const spread_opts& opts);
-static inline void evaluate_kernel_vector(FLT *ker, FLT *args, const spread_opts& opts, const int N);
-static inline void eval_kernel_vec_Horner(FLT *ker, const FLT z, const int w, const spread_opts &opts);
-void interp_line(FLT *out,FLT *du, FLT *ker,BIGINT i1,BIGINT N1,int ns);
-void interp_square(FLT *out,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i2,BIGINT N1,BIGINT N2,int ns);
-void interp_cube(FLT *out,FLT *du, FLT *ker1, FLT *ker2, FLT *ker3,
-		 BIGINT i1,BIGINT i2,BIGINT i3,BIGINT N1,BIGINT N2,BIGINT N3,int ns);
-void spread_subproblem_1d(BIGINT off1, BIGINT size1,FLT *du0,BIGINT M0,FLT *kx0,
-                          FLT *dd0,const spread_opts& opts);
-void spread_subproblem_2d(BIGINT off1, BIGINT off2, BIGINT size1,BIGINT size2,
+// (those templated on ns, the kernel width, get a specialized copy per ns, and
+// on W, the SIMD vector length in FLTs, a copy per instruction set; they are
+// force-inlined into the per-ISA entry points, see set_spread_kernels for how
+// these are selected once per plan)
+template<int ns>
+static SIMD_INLINE void set_kernel_args(FLT *args, FLT x);
+static SIMD_INLINE void evaluate_kernel_vector(FLT *ker, FLT *args, const spread_opts& opts, const int N);
+template<int w>
+static SIMD_INLINE void eval_kernel_vec_Horner(FLT *ker, const FLT z, const spread_opts &opts);
+template<int ns>
+static SIMD_INLINE void interp_line(FLT *out,FLT *du, FLT *ker,BIGINT i1,BIGINT N1);
+template<int ns, int W>
+static SIMD_INLINE void interp_square(FLT *out,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i2,BIGINT N1,BIGINT N2);
+template<int ns, int W>
+static SIMD_INLINE void interp_cube(FLT *out,FLT *du, FLT *ker1, FLT *ker2, FLT *ker3,
+		 BIGINT i1,BIGINT i2,BIGINT i3,BIGINT N1,BIGINT N2,BIGINT N3);
+template<int ns>
+static SIMD_INLINE void spread_subproblem_1d(BIGINT off1, BIGINT size1,FLT *du0,BIGINT M0,FLT *kx0,
+                          FLT *dd0,int nvec,BIGINT *i0,FLT *kv,
+                          const spread_opts& opts);
+template<int ns, int W>
+static SIMD_INLINE void spread_subproblem_2d(BIGINT off1, BIGINT off2, BIGINT size1,BIGINT size2,
                           FLT *du0,BIGINT M0,
-			  FLT *kx0,FLT *ky0,FLT *dd0,const spread_opts& opts);
-void spread_subproblem_3d(BIGINT off1,BIGINT off2, BIGINT off3, BIGINT size1,
+			  FLT *kx0,FLT *ky0,FLT *dd0,int nvec,BIGINT *i0,FLT *kv,
+                          const spread_opts& opts);
+template<int ns, int W>
+static SIMD_INLINE void spread_subproblem_3d(BIGINT off1,BIGINT off2, BIGINT off3, BIGINT size1,
                           BIGINT size2,BIGINT size3,FLT *du0,BIGINT M0,
-			  FLT *kx0,FLT *ky0,FLT *kz0,FLT *dd0,
-			  const spread_opts& opts);
+			  FLT *kx0,FLT *ky0,FLT *kz0,FLT *dd0,int nvec,
+			  BIGINT *i0,FLT *kv,const spread_opts& opts);
+template<int ns>
+static void ker_point(BIGINT *i0, FLT *ker, int ndims, FLT *x,
+                      const spread_opts *opts);
+template<int ns>
+static SIMD_INLINE void spread_line(FLT *du, FLT *src, FLT *ker, BIGINT i1, BIGINT N1);
+template<int ns, int W>
+static SIMD_INLINE void spread_square(FLT *du, FLT *src, FLT *ker1, FLT *ker2,
+                                      BIGINT i1, BIGINT i2, BIGINT N1, BIGINT N2);
+template<int ns, int W>
+static SIMD_INLINE void spread_cube(FLT *du, FLT *src, FLT *ker1, FLT *ker2, FLT *ker3,
+                                    BIGINT i1, BIGINT i2, BIGINT i3,
+                                    BIGINT N1, BIGINT N2, BIGINT N3);
+static int set_spread_kernels(spread_opts &opts);
 void add_wrapped_subgrid(BIGINT offset1,BIGINT offset2,BIGINT offset3,
 			 BIGINT size1,BIGINT size2,BIGINT size3,BIGINT N1,
 			 BIGINT N2,BIGINT N3,FLT *data_uniform, FLT *du0);
 void add_wrapped_subgrid_thread_safe(BIGINT offset1,BIGINT offset2,BIGINT offset3,
                                      BIGINT size1,BIGINT size2,BIGINT size3,BIGINT N1,
                                      BIGINT N2,BIGINT N3,FLT *data_uniform, FLT *du0);
-void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+static void add_subgrid_ghost(BIGINT *g, BIGINT *P, FLT *du, FLT *du0,
+                              bool atomic);
+static void copy_wrapped_subgrid(BIGINT *g, BIGINT N1, BIGINT N2, BIGINT N3,
+                                 BIGINT *P, FLT *du, FLT *du0);
+template <class I>
+void bin_sort_singlethread(I *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,
-	      double bin_size_x,double bin_size_y,double bin_size_z, int debug);
-void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+	      double bin_size_x,double bin_size_y,double bin_size_z,
+              int bin_order, int debug);
+template <class I>
+void bin_sort_multithread(I *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,
-              double bin_size_x,double bin_size_y,double bin_size_z, int debug,
-              int nthr);
+              double bin_size_x,double bin_size_y,double bin_size_z,
+              int bin_order, int debug, int nthr);
+template <class I>
+static void bin_offsets(std::vector<I> &offsets,
+                        const std::vector<I> &counts, BIGINT nbins1,
+                        BIGINT nbins2, BIGINT nbins3, int bin_order);
 void get_subgrid(BIGINT &offset1,BIGINT &offset2,BIGINT &offset3,BIGINT &size1,
 		 BIGINT &size2,BIGINT &size3,BIGINT M0,FLT* kx0,FLT* ky0,
 		 FLT* kz0,int ns, int ndims);
@@ -59,8 +100,32 @@ void get_subgrid(BIGINT &offset1,BIGINT &offset2,BIGINT &offset3,BIGINT &size1,
          (x + (x>=-PI ? (x<PI ? PI : -PI) : 3*PI)) * ((FLT)M_1_2PI*N) : \
                         (x>=0.0 ? (x<(FLT)N ? x : x-(FLT)N) : x+(FLT)N))
 
+// spreadSorted auto-chooses direct (single-thread, no subgrid) spreading, even
+// if more threads are available, when fewer than one NU pt per this many U pts
+#define DIRECT_SPREAD_DENSITY 100
 
 
+
+template <class I>
+static int sort_spreadinterp(I*, BIGINT N1, BIGINT N2, BIGINT N3,
+                             FLT *data_uniform, BIGINT M, FLT *kx, FLT *ky,
+                             FLT *kz, FLT *data_nonuniform, spread_opts opts)
+// helper for spreadinterp: sorts with sort indices of type I (the first arg,
+// NULL, only selects I), then spreads or interps.
+{
+  I* sort_indices = (I*)malloc(sizeof(I)*M);
+  if (!sort_indices) {
+    fprintf(stderr,"%s failed to allocate sort_indices!\n",__func__);
+    return ERR_SPREAD_ALLOC;
+  }
+  int did_sort = indexSort(sort_indices, N1, N2, N3, M, kx, ky, kz, opts);
+  int ier = spreadinterpSorted(sort_indices, N1, N2, N3, data_uniform,
+                               M, kx, ky, kz, data_nonuniform, opts, did_sort,
+                               NULL, 0, 1, NULL);
+  free(sort_indices);
+  return ier;
+}
+
 // ==========================================================================
 int spreadinterp(
         BIGINT N1, BIGINT N2, BIGINT N3, FLT *data_uniform,
@@ -136,21 +201,17 @@ int spreadinterp(
    Melody Shih split into 3 routines: check, sort, spread. Jun 2018, making
    this routine just a caller to them. Name change, Barnett 7/27/18
    Tidy, Barnett 5/20/20. Tidy doc, Barnett 10/22/20.
+   32-bit sort indices when M fits.
 */
 {
   int ier = spreadcheck(N1, N2, N3, M, kx, ky, kz, opts);
   if (ier)
     return ier;
-  BIGINT* sort_indices = (BIGINT*)malloc(sizeof(BIGINT)*M);
-  if (!sort_indices) {
-    fprintf(stderr,"%s failed to allocate sort_indices!\n",__func__);
-    return ERR_SPREAD_ALLOC;
-  }
-  int did_sort = indexSort(sort_indices, N1, N2, N3, M, kx, ky, kz, opts);
-  spreadinterpSorted(sort_indices, N1, N2, N3, data_uniform,
-                     M, kx, ky, kz, data_nonuniform, opts, did_sort);
-  free(sort_indices);
-  return 0;
+  if (sortidx32_fits(M))        // 32-bit sort indices when M allows
+    return sort_spreadinterp((uint32_t*)NULL, N1, N2, N3, data_uniform, M, kx,
+                             ky, kz, data_nonuniform, opts);
+  return sort_spreadinterp((BIGINT*)NULL, N1, N2, N3, data_uniform, M, kx, ky,
+                           kz, data_nonuniform, opts);
 }
 
 static int ndims_from_Ns(BIGINT N1, BIGINT N2, BIGINT N3)
@@ -217,7 +278,61 @@ int spreadcheck(BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, FLT *kx, FLT *ky,
 }
 
 
-int indexSort(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, 
+static void get_bin_sizes(double *bs, BIGINT N1, BIGINT N2, BIGINT N3,
+                          const spread_opts &opts)
+/* Writes to bs[0..2] the sizes (in grid pts) of the boxes that NU pts are
+   binned into by indexSort: opts.bin_size_x,y,z where these are >0, else
+   heuristic ones. The grid pts touched by the stencils of a bin's pts (the
+   bin grown by ns-1 per dim) should stay in cache while the bin is done, so
+   starting from the old fixed 16x4x4 (x is favored 4:1 since its rows are
+   contiguous), bins are grown by doubling the least grown dim while they
+   touch at most 2x the L1 and 1/8 of the L2 cache (cache_bytes), and no
+   more than the dim's size: eg 32x8x16 for ns=4 (tol 1e-3), single, and a
+   32KB L1, 1MB L2; still 16x4x4 for ns>=10. A dim so short that a bin's
+   stencils span it is one bin across, others are cut into equal bins.
+   Also used by setup_spread_plan and numa_slabs, which work in whole bins, so
+   all must agree (it depends only on its inputs and the machine).
+*/
+{
+  BIGINT Nd[3] = {N1,N2,N3};
+  int ns = opts.nspread;
+  double maxpts = min(2.0*cache_bytes(1), cache_bytes(2)/8.0)/(2*sizeof(FLT));
+  const double w[3] = {4,1,1};           // aspect weights of the growth
+  double b[3] = {N1>1 ? 16.0 : 1, N2>1 ? 4.0 : 1, N3>1 ? 4.0 : 1};
+  auto touched = [&](double *c) {        // # grid pts a bin c's stencils hit
+      double p = 1;
+      for (int d=0; d<3; ++d)
+        if (Nd[d]>1) p *= min(c[d]+ns-1, (double)Nd[d]);
+      return p;
+    };
+  while (true) {          // double the least grown dim (ties: slowest) if fits
+    int dbest = -1;
+    for (int d=2; d>=0; --d) {
+      double c[3] = {b[0],b[1],b[2]};
+      c[d] *= 2;
+      if (Nd[d]==1 || c[d]>Nd[d] || touched(c)>maxpts)
+        continue;
+      if (dbest<0 || b[d]/w[d] < b[dbest]/w[dbest])
+        dbest = d;
+    }
+    if (dbest<0) break;
+    b[dbest] *= 2;
+  }
+  int user[3] = {opts.bin_size_x, opts.bin_size_y, opts.bin_size_z};
+  for (int d=0; d<3; ++d) {
+    if (user[d]>0)
+      bs[d] = user[d];
+    else if (Nd[d]==1)
+      bs[d] = 1;                         // (unused dim)
+    else if (b[d]+ns-1>=Nd[d])
+      bs[d] = Nd[d];                     // one bin across
+    else
+      bs[d] = Nd[d]/ceil(Nd[d]/b[d]);    // equal bins, no thin last one
+  }
+}
+
+template <class I>
+int indexSort(I* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, 
                FLT *kx, FLT *ky, FLT *kz, spread_opts opts)
 /* This makes a decision whether or not to sort the NU pts (influenced by
    opts.sort), and if yes, calls either single- or multi-threaded bin sort,
@@ -249,9 +364,8 @@ int indexSort(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M,
   int ndims = ndims_from_Ns(N1,N2,N3);
   BIGINT N=N1*N2*N3;            // U grid (periodic box) sizes
   
-  // heuristic binning box size for U grid... affects performance:
-  double bin_size_x = 16, bin_size_y = 4, bin_size_z = 4;
-  // put in heuristics based on cache sizes (only useful for single-thread) ?
+  double bs[3];                 // binning box size for U grid
+  get_bin_sizes(bs,N1,N2,N3,opts);
 
   int better_to_sort = !(ndims==1 && (opts.spread_direction==2 || (M > 1000*N1))); // 1D small-N or dir=2 case: don't sort
 
@@ -268,11 +382,11 @@ int indexSort(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M,
     if (sort_nthr==0)   // use auto choice: when N>>M, one thread is better!
       sort_nthr = (10*M>N) ? maxnthr : 1;      // heuristic
     if (sort_nthr==1)
-      bin_sort_singlethread(sort_indices,M,kx,ky,kz,N1,N2,N3,opts.pirange,bin_size_x,bin_size_y,bin_size_z,sort_debug);
+      bin_sort_singlethread(sort_indices,M,kx,ky,kz,N1,N2,N3,opts.pirange,bs[0],bs[1],bs[2],opts.bin_order,sort_debug);
     else                                      // sort_nthr>1, sets # threads
-      bin_sort_multithread(sort_indices,M,kx,ky,kz,N1,N2,N3,opts.pirange,bin_size_x,bin_size_y,bin_size_z,sort_debug,sort_nthr);
+      bin_sort_multithread(sort_indices,M,kx,ky,kz,N1,N2,N3,opts.pirange,bs[0],bs[1],bs[2],opts.bin_order,sort_debug,sort_nthr);
     if (opts.debug) 
-      printf("\tsorted (%d threads):\t%.3g s\n",sort_nthr,timer.elapsedsec());
+      printf("\tsorted (%d threads, bins %.3gx%.3gx%.3g, order %d):\t%.3g s\n",sort_nthr,bs[0],N2>1 ? bs[1] : 1.0,N3>1 ? bs[2] : 1.0,opts.bin_order,timer.elapsedsec());
     did_sort=1;
   } else {
 #pragma omp parallel for num_threads(maxnthr) schedule(static,1000000)
@@ -285,162 +399,1105 @@ int indexSort(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M,
 }
 
 
-int spreadinterpSorted(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, 
+#define ARENA_ALIGN 64   // byte alignment of spread plan arena buffers
+#define INTERP_SUBGRID_BYTES (1<<19)   // cap on interp subgrids per slot (<L2)
+#define MAX_CHUNK_NVEC 16   // max # vectors fused per chunk (stack buffers)
+
+static inline BIGINT arena_pad(BIGINT n)
+// rounds up a number of FLTs so that the next arena buffer stays aligned
+{
+  BIGINT a = ARENA_ALIGN/sizeof(FLT);
+  return a*((n+a-1)/a);
+}
+
+template <class I>
+static inline BIGINT sorted_bin(BIGINT j, I* sort_indices, FLT *ks,
+                                BIGINT Ns, double bin_size,
+                                const spread_opts &opts)
+// bin index in one dim (coords ks, size Ns) of the j'th NU pt in sorted
+// order. Must be computed exactly as in bin_sort_*.
+{
+  if (opts.sorted_pts)          // (already folded, as bin_sort_* did)
+    return ks[j]/bin_size;
+  return FOLDRESCALE(ks[sort_indices[j]],Ns,opts.pirange)/bin_size;
+}
+
+template <class I>
+static BIGINT first_in_bin(BIGINT b, BIGINT lo, BIGINT hi,
+                           I* sort_indices, FLT *ks, BIGINT Ns,
+                           double bin_size, const spread_opts &opts)
+// index of the 1st sorted NU pt in [lo,hi) whose bin in the slowest dim (coords
+// ks, size Ns) is >=b, or hi if none. Since bin_sort orders the bins with the
+// slowest dim outermost, these bins never decrease along the sorted list,
+// allowing binary search.
+{
+  while (lo<hi) {
+    BIGINT mid = lo + (hi-lo)/2;
+    if (sorted_bin(mid,sort_indices,ks,Ns,bin_size,opts)<b)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+template <class I>
+static void numa_slabs(std::vector<BIGINT> &jb, int nthr, I* sort_indices,
+                       BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, FLT *kx,
+                       FLT *ky, FLT *kz, const spread_opts &opts)
+/* For opts.numa=2: splits the bin-sorted NU pts among nthr threads by where
+   they are in the grid. Writes jb (length nthr+1), breakpoints such that
+   thread t gets the pts in the bins starting in the t'th of nthr equal slabs
+   of the slowest dim, ie (up to the kernel width) the part of the grid whose
+   pages it first touched, as static OMP blocks (see finufft.cpp's
+   PLACE_FINE_GRIDS). This favors locality over load balance.
+*/
+{
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  BIGINT Ns = (ndims==1) ? N1 : ((ndims==2) ? N2 : N3);  // slowest dim size
+  FLT *ks = (ndims==1) ? kx : ((ndims==2) ? ky : kz);
+  double bin_size[3];
+  get_bin_sizes(bin_size,N1,N2,N3,opts);
+  double bs = bin_size[ndims-1];
+  jb.assign(nthr+1,M);
+  jb[0] = 0;
+  for (int t=1; t<nthr; ++t) {
+    BIGINT b = (BIGINT)ceil(Ns*t/(nthr*bs));   // 1st bin starting in slab t
+    jb[t] = first_in_bin(b,jb[t-1],M,sort_indices,ks,Ns,bs,opts);
+  }
+}
+
+static inline double subprob_cost(BIGINT M0, BIGINT size, int ns, int ndims)
+// rough relative cost of spreading M0 NU pts to a subgrid of size pts: the
+// ns^ndims stencil updates per pt, plus zeroing and adding the subgrid.
+{
+  return M0*pow((double)ns,ndims) + 2.0*size;
+}
+
+template <class I>
+static int balanced_breaks(std::vector<BIGINT> &brk, BIGINT j0, BIGINT j1,
+                           BIGINT maxM0, double maxsize, I* sort_indices,
+                           BIGINT N1, BIGINT N2, BIGINT N3, FLT *kx, FLT *ky,
+                           FLT *kz, const spread_opts &opts)
+/* Splits the bin-sorted NU pts j0<=j<j1 into subprobs made of runs of whole
+   bins (in their sorted order), each with at most maxM0 pts, and whose bins'
+   bounding box, padded by the kernel width, has at most maxsize grid pts.
+   A bin holding more than maxM0 pts is split into equal parts. A subprob
+   thus never straddles bins far apart, as an equal-count chunk of clustered
+   pts may, which gives a huge subgrid. Appends the breakpoints (the first
+   being j0, not including j1) to brk, and returns the # subprobs.
+*/
+{
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  int ns = opts.nspread;
+  double bs[3];
+  get_bin_sizes(bs,N1,N2,N3,opts);
+  BIGINT Nd[3] = {N1,N2,N3};
+  FLT *kd[3] = {kx,ky,kz};
+  int nb = 0;
+  BIGINT s = j0;                       // 1st pt of the subprob being built
+  BIGINT lo[3], hi[3];                 // its bins' index ranges per dim
+  BIGINT a = j0;                       // 1st pt of the current bin
+  while (a<j1) {
+    BIGINT ib[3] = {0,0,0};            // current bin's indices
+    for (int d=0; d<ndims; ++d)
+      ib[d] = sorted_bin(a,sort_indices,kd[d],Nd[d],bs[d],opts);
+    BIGINT b = a+1;                    // find end of the bin's run
+    while (b<j1) {
+      bool same = true;
+      for (int d=0; d<ndims && same; ++d)
+        same = (sorted_bin(b,sort_indices,kd[d],Nd[d],bs[d],opts)==ib[d]);
+      if (!same) break;
+      ++b;
+    }
+    if (b-a>maxM0) {                   // one heavy bin: close subprob, split bin
+      if (s<a) { brk.push_back(s); ++nb; }
+      BIGINT q = 1 + (b-a-1)/maxM0;
+      for (BIGINT r=0; r<q; ++r) {
+        brk.push_back(a + (BIGINT)(0.5 + (b-a)*r/(double)q));
+        ++nb;
+      }
+      s = b;
+    } else {
+      double size = 1.0;               // padded box size if bin were added
+      for (int d=0; d<ndims; ++d) {
+        BIGINT l = (s<a) ? min(lo[d],ib[d]) : ib[d];
+        BIGINT h = (s<a) ? max(hi[d],ib[d]) : ib[d];
+        size *= min((double)Nd[d], (h-l+1)*bs[d] + ns);
+      }
+      if (s<a && (b-s>maxM0 || size>maxsize)) {   // close subprob before bin
+        brk.push_back(s); ++nb;
+        s = a;
+      }
+      for (int d=0; d<ndims; ++d) {
+        lo[d] = (s<a) ? min(lo[d],ib[d]) : ib[d];
+        hi[d] = (s<a) ? max(hi[d],ib[d]) : ib[d];
+      }
+    }
+    a = b;
+  }
+  if (s<j1) { brk.push_back(s); ++nb; }
+  return nb;
+}
+
+static void print_subprob_stats(SPREAD_PLAN *sp, int ns, int ndims, BIGINT N,
+                                int nthr)
+// debug: subgrid sizes against # NU pts of the subprobs, and the load
+// balance predicted by the cost model if nthr threads take them in plan
+// order (or, if tiled, each tile's thread does its own).
+{
+  BIGINT maxM0 = 0, maxsize = 0;
+  double tsize = 0.0, maxratio = 0.0, tcost = 0.0, maxcost = 0.0;
+  int nt = sp->ntiles;
+  std::vector<double> load(nt ? nt : max(nthr,1),0.0);  // per thread
+  for (int k=0, t=0; k<sp->nb; ++k) {
+    int isub = sp->order[k];
+    while (nt && isub>=sp->tilesub[t+1]) ++t;     // (tiles keep plan order)
+    BIGINT M0 = sp->brk[isub+1]-sp->brk[isub];
+    BIGINT *g = sp->subgrid + 6*isub;
+    BIGINT size = g[3]*g[4]*g[5];
+    double c = subprob_cost(M0,size,ns,ndims);
+    maxM0 = max(maxM0,M0);
+    maxsize = max(maxsize,size);
+    tsize += size;
+    if (M0>0) maxratio = max(maxratio,size/(double)M0);
+    tcost += c;
+    maxcost = max(maxcost,c);
+    if (nt)
+      load[t] += c;
+    else                              // greedy, as dynamic scheduling
+      *std::min_element(load.begin(),load.end()) += c;
+  }
+  BIGINT M = sp->brk[sp->nb];
+  printf("\tsubprobs: max M0=%lld (mean %.3g), max subgrid=%lld (mean %.3g), total subgrid %.3g*N\n",(long long)maxM0,M/(double)sp->nb,(long long)maxsize,tsize/sp->nb,tsize/N);
+  printf("\t\tsubgrid/M0 mean %.3g max %.3g; est cost max/mean %.3g, makespan/ideal %.3g (%d thr)\n",tsize/M,maxratio,maxcost*sp->nb/tcost,*std::max_element(load.begin(),load.end())*load.size()/tcost,(int)load.size());
+}
+
+template <class I>
+void fold_sorted_pts(FLT *kxs, FLT *kys, FLT *kzs, I* sort_indices,
+                     BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, FLT *kx,
+                     FLT *ky, FLT *kz, spread_opts opts)
+/* Writes the NU pts kx (ky, kz if N2>1, N3>1), folded and rescaled to [0,N)
+   grid units, and permuted into sorted order, to the contiguous arrays kxs
+   (kys, kzs), which the caller allocates. Ie, kxs[j] is the folded
+   kx[sort_indices[j]]. spreadSorted, interpSorted, setup_spread_plan and
+   setup_ker_cache may then be given kxs.. with opts.sorted_pts=1, so that
+   they stream the coords rather than gather and fold them each time.
+*/
+{
+  int nthr = MY_OMP_GET_MAX_THREADS();
+  if (opts.nthreads>0)
+    nthr = min(nthr,opts.nthreads);
+#pragma omp parallel for num_threads(nthr) schedule(static,100000)
+  for (BIGINT j=0; j<M; j++) {
+    BIGINT kk = sort_indices[j];
+    kxs[j] = FOLDRESCALE(kx[kk],N1,opts.pirange);
+    if (N2>1) kys[j] = FOLDRESCALE(ky[kk],N2,opts.pirange);
+    if (N3>1) kzs[j] = FOLDRESCALE(kz[kk],N3,opts.pirange);
+  }
+}
+
+template <class I>
+int setup_spread_plan(SPREAD_PLAN **spp, I* sort_indices, BIGINT N1,
+                      BIGINT N2, BIGINT N3, BIGINT M, FLT *kx, FLT *ky,
+                      FLT *kz, spread_opts opts, int did_sort, int nslots,
+                      int nvec)
+/* Builds the t1 spreading layout of the sorted NU pts (the split of the
+   sorted index list into subproblems, and the subgrid of each), plus an arena
+   with one slot per worker, each big enough for the NU pt copies and subgrid
+   of the largest subproblem. A ptr to the new plan is written to *spp.
+   This depends only on the NU pts, so may be done once (eg at setpts) then
+   used by spreadSorted for any number of strength vectors, which then needs
+   no heap allocation.
+   If opts.method=2, the grid is also split into owner-computes tiles: slabs
+   of whole bins in the slowest dim, with about M/nthreads NU pts in each, the
+   subproblems then never crossing a tile, and halo buffers are allocated.
+   This needs the NU pts bin-sorted (with the slowest dim outermost, ie
+   opts.bin_order=0) and nthreads>1; otherwise the plain subproblems
+   (method=1) are used.
+   If opts.balance=1 (and the pts are sorted), subproblems are instead runs of
+   whole bins (see balanced_breaks), so that clustered pts don't give huge
+   subgrids, and (if not tiled) are ordered by decreasing estimated cost for
+   the dynamic schedule. With opts.debug, subgrid vs NU pt stats are shown.
+   If opts.spread_direction=2, the plan is instead for interpSorted with
+   opts.interp_method=1: the same balanced split (if sorted) but with subgrids
+   capped to fit in L2 cache (INTERP_SUBGRID_BYTES per slot) and grown by one
+   grid pt per side, no tiles, and slots holding only the nvec subgrids.
+
+   Inputs: sort_indices, N1,N2,N3, M, kx,ky,kz, opts, did_sort: as passed to
+             spreadSorted (see spreadinterp() for their meaning).
+           nslots - # workers that may use the arena simultaneously, ie the
+             total # threads over all concurrent spreadSorted calls.
+           nvec - max # strength vectors spreadSorted will spread at once
+             (fused, sharing kernel evaluations); each slot, and the halos,
+             hold that many strength copies and subgrids.
+   Returns 0, or ERR_SPREAD_ALLOC if allocation failed (then *spp is NULL).
+   The plan must be freed by destroy_spread_plan.
+   The choice of # subproblems moved here from spreadSorted.
+*/
+{
+  CNTime timer; timer.start();
+  *spp = NULL;
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  BIGINT N=N1*N2*N3;
+  int ns=opts.nspread;
+  int nthr = MY_OMP_GET_MAX_THREADS();  // # threads spreadSorted would use
+  if (opts.nthreads>0)
+    nthr = min(nthr,opts.nthreads);     // user override up to max avail
+  bool interp = (opts.spread_direction==2);   // subgrids for interpSorted?
+  int method = (opts.method==0 || interp) ? 1 : opts.method;   // auto-choice, for now
+  BIGINT Ns = (ndims==1) ? N1 : ((ndims==2) ? N2 : N3);  // slowest dim size
+
+  // split into tiles: since bin_sort orders the bins with the slowest dim
+  // outermost, a run of whole bins in that dim is contiguous in the sorted
+  // list, and bin indices never decrease along it, allowing binary search...
+  std::vector<BIGINT> tbrk, tplane;   // tile NU pt breakpoints, 1st own planes
+  if (method==2 && did_sort && nthr>1 && opts.bin_order==0) {
+    double bin_size[3];
+    get_bin_sizes(bin_size,N1,N2,N3,opts);
+    double bs = bin_size[ndims-1];
+    FLT *ks = (ndims==1) ? kx : ((ndims==2) ? ky : kz);
+    tbrk.push_back(0);
+    tplane.push_back(0);
+    BIGINT b = 0;                       // first bin of latest tile
+    for (int t=1; t<nthr; ++t) {
+      BIGINT j = (BIGINT)(0.5 + M*t/(double)nthr);  // ideal NU pt breakpoint
+      if (j>=M) break;
+      b = max(b+1,sorted_bin(j,sort_indices,ks,Ns,bs,opts));
+      BIGINT plane = (BIGINT)ceil(b*bs);   // 1st plane in bin b
+      if (plane>=Ns) break;                // no planes left to own
+      tbrk.push_back(first_in_bin(b,tbrk.back(),M,sort_indices,ks,Ns,bs,opts));
+      tplane.push_back(plane);
+    }
+    tbrk.push_back(M);
+    tplane.push_back(Ns);
+    if (tbrk.size()<3) {                  // one tile is pointless
+      tbrk.clear();
+      tplane.clear();
+    }
+  }
+  int nt = tbrk.empty() ? 0 : (int)tbrk.size()-1;   // # tiles
+  if (method==2 && nt==0 && opts.debug)
+    printf("\tcannot tile (did_sort=%d, nthr=%d, bin_order=%d): using plain subprobs\n",did_sort,nthr,opts.bin_order);
+
+  // choose nb (# subprobs) via used nthreads, or, if tiled, per tile:
+  std::vector<BIGINT> tnb(nt);          // # subprobs in each tile
+  std::vector<BIGINT> brk;              // their NU index breakpoints
+  int nb = min((BIGINT)nthr,M);         // simply split one subprob per thr...
+  // balanced split: whole bins, capped in # pts (~4 subprobs per thread, for
+  // the dynamic schedule to even out), and in subgrid size at 4x that of the
+  // mean density (not with the low-density rescue below)...
+  bool balance = (opts.balance || interp) && did_sort && M*1000>=N;
+  double capsize = 0.0;                 // subgrid size cap, if balance
+  if (balance) {
+    double bin_size[3];
+    get_bin_sizes(bin_size,N1,N2,N3,opts);
+    double binsize = 1.0;               // padded size of a single bin
+    BIGINT Nd[3] = {N1,N2,N3};
+    for (int d=0; d<ndims; ++d)
+      binsize *= min((double)Nd[d], bin_size[d]+ns);
+    BIGINT capM0 = min((BIGINT)opts.max_subproblem_size, 1+(M-1)/(4*nthr));
+    capsize = max(binsize, 4.0*capM0*N/(double)M);
+    if (interp)                         // (pts per subprob matter less)
+      capsize = max(binsize, INTERP_SUBGRID_BYTES/(2.0*sizeof(FLT)*max(nvec,1)));
+    if (nt) {
+      nb = 0;
+      for (int t=0; t<nt; ++t) {        // (tiles are per-thread already)
+        tnb[t] = balanced_breaks(brk, tbrk[t], tbrk[t+1], opts.max_subproblem_size, capsize, sort_indices, N1,N2,N3, kx,ky,kz, opts);
+        nb += tnb[t];
+      }
+    } else
+      nb = balanced_breaks(brk, 0, M, capM0, capsize, sort_indices, N1,N2,N3, kx,ky,kz, opts);
+    if (opts.debug) printf("\tbalanced split into %d subprobs of whole bins (max subgrid %.3g)\n",nb,capsize);
+  }
+  if (nt) {
+    if (!balance) {
+      nb = 0;
+      for (int t=0; t<nt; ++t) {        // ...or per tile, to cap size
+        BIGINT Mt = tbrk[t+1]-tbrk[t];
+        tnb[t] = (Mt==0) ? 0 : 1 + (Mt-1)/opts.max_subproblem_size;
+        if (M*1000<N)                   // low-density, as below
+          tnb[t] = Mt;
+        for (BIGINT q=0; q<tnb[t]; ++q)
+          brk.push_back(tbrk[t] + (BIGINT)(0.5 + Mt*q/(double)tnb[t]));
+        nb += tnb[t];
+      }
+    }
+    if (opts.debug) printf("\tsplit into %d tiles\n",nt);
+  } else if (!balance) {
+    if (nb*(BIGINT)opts.max_subproblem_size<M) {  // ...or more subprobs to cap size
+      nb = 1 + (M-1)/opts.max_subproblem_size;  // int div does ceil(M/opts.max_subproblem_size)
+      if (opts.debug) printf("\tcapping subproblem sizes to max of %d\n",opts.max_subproblem_size);
+    }
+    if (M*1000<N) {         // low-density heuristic: one thread per NU pt!
+      nb = M;
+      if (opts.debug) printf("\tusing low-density speed rescue nb=M...\n");
+    }
+    if (!did_sort && nthr==1) {
+      nb = 1;
+      if (opts.debug) printf("\tunsorted nthr=1: forcing single subproblem...\n");
+    }
+    for (int p=0;p<nb;++p)    // NU index breakpoints defining nb subproblems
+      brk.push_back((BIGINT)(0.5 + M*p/(double)nb));
+  }
+  brk.push_back(M);
+
+  SPREAD_PLAN *sp = (SPREAD_PLAN*)malloc(sizeof(SPREAD_PLAN));
+  if (!sp) {
+    fprintf(stderr,"%s failed to allocate spread plan!\n",__func__);
+    return ERR_SPREAD_ALLOC;
+  }
+  sp->nb = nb;
+  sp->brk = (BIGINT*)malloc(sizeof(BIGINT)*(nb+1));
+  sp->subgrid = (BIGINT*)malloc(sizeof(BIGINT)*6*(nb+1));  // +1 so nb=0 ok
+  sp->order = (int*)malloc(sizeof(int)*(nb+1));
+  sp->arena = NULL;
+  sp->ntiles = nt;
+  sp->tilesub = (int*)malloc(sizeof(int)*(nt+1));
+  sp->tileplane = (BIGINT*)malloc(sizeof(BIGINT)*(nt+1));
+  sp->halo = (BIGINT*)malloc(sizeof(BIGINT)*4*(nt+1));
+  sp->halobuf = NULL;
+  sp->halostride = 0;
+  if (!sp->brk || !sp->subgrid || !sp->order || !sp->tilesub || !sp->tileplane || !sp->halo) {
+    fprintf(stderr,"%s failed to allocate subproblem lists!\n",__func__);
+    destroy_spread_plan(sp);
+    return ERR_SPREAD_ALLOC;
+  }
+  std::copy(brk.begin(), brk.end(), sp->brk);
+  for (int p=0;p<nb;++p)
+    sp->order[p] = p;
+  if (nt) {        // the subprobs within each tile
+    int p = 0;
+    for (int t=0; t<nt; ++t) {
+      sp->tilesub[t] = p;
+      sp->tileplane[t] = tplane[t];
+      p += tnb[t];
+    }
+    sp->tilesub[nt] = nb;
+    sp->tileplane[nt] = Ns;
+  }
+
+  // get each subgrid from NU pts folded exactly as spreadSorted will do...
+  BIGINT maxM0 = 0, maxsize = 0;
+#pragma omp parallel num_threads(nthr)
+  {
+    std::vector<FLT> kx0, ky0, kz0;     // (setup only, so allocating is ok)
+    BIGINT tmaxM0 = 0, tmaxsize = 0;    // this thread's maxima
+#pragma omp for schedule(dynamic,1)
+    for (int isub=0; isub<nb; isub++) {
+      BIGINT M0 = sp->brk[isub+1]-sp->brk[isub];  // # NU pts in this subprob
+      kx0.resize(M0);
+      if (N2>1) ky0.resize(M0);
+      if (N3>1) kz0.resize(M0);
+      for (BIGINT j=0; j<M0; j++) {
+        if (opts.sorted_pts) {
+          BIGINT kk=j+sp->brk[isub];
+          kx0[j]=kx[kk];
+          if (N2>1) ky0[j]=ky[kk];
+          if (N3>1) kz0[j]=kz[kk];
+          continue;
+        }
+        BIGINT kk=sort_indices[j+sp->brk[isub]];
+        kx0[j]=FOLDRESCALE(kx[kk],N1,opts.pirange);
+        if (N2>1) ky0[j]=FOLDRESCALE(ky[kk],N2,opts.pirange);
+        if (N3>1) kz0[j]=FOLDRESCALE(kz[kk],N3,opts.pirange);
+      }
+      BIGINT *g = sp->subgrid + 6*isub;  // offset1,2,3, size1,2,3
+      get_subgrid(g[0],g[1],g[2],g[3],g[4],g[5],M0,kx0.data(),ky0.data(),kz0.data(),ns,ndims);
+      if (interp)                      // margin for rounding of local coords
+        for (int d=0; d<ndims; d++) {
+          g[d] -= 1;
+          g[3+d] += 2;
+        }
+      tmaxM0 = max(tmaxM0,M0);
+      tmaxsize = max(tmaxsize,g[3]*g[4]*g[5]);
+    }
+#pragma omp critical
+    {
+      maxM0 = max(maxM0,tmaxM0);
+      maxsize = max(maxsize,tmaxsize);
+    }
+  }
+  sp->maxM0 = maxM0;
+  sp->maxsize = maxsize;
+  if (balance && !nt) {   // hand out costliest subprobs first, not last
+    std::vector<double> cost(nb);
+    for (int isub=0; isub<nb; isub++) {
+      BIGINT *g = sp->subgrid + 6*isub;
+      cost[isub] = subprob_cost(sp->brk[isub+1]-sp->brk[isub],g[3]*g[4]*g[5],ns,ndims);
+    }
+    std::stable_sort(sp->order, sp->order+nb,
+                     [&cost](int i, int j) { return cost[i]>cost[j]; });
+  }
+  if (opts.debug && nb>0)
+    print_subprob_stats(sp, ns, ndims, N, nthr);
+
+  // arena slot: kx0 (ky0, kz0 if needed), nvec dd0's, then nvec du0's, aligned...
+  sp->nslots = max(nslots,1);
+  sp->nvec = max(nvec,1);
+  sp->slotsize = ndims*arena_pad(maxM0) + arena_pad(2*maxM0*sp->nvec) + arena_pad(2*maxsize*sp->nvec);
+  if (interp)                           // interp: just nvec subgrids
+    sp->slotsize = arena_pad(2*maxsize*sp->nvec);
+  sp->arena = (FLT*)alloc_aligned(sizeof(FLT)*sp->nslots*sp->slotsize, ARENA_ALIGN);
+  if (!sp->arena) {
+    fprintf(stderr,"%s failed to allocate arena (%d slots of %lld FLTs)!\n",__func__,sp->nslots,(long long)sp->slotsize);
+    destroy_spread_plan(sp);
+    return ERR_SPREAD_ALLOC;
+  }
+
+  if (nt) {    // each tile's halo: the planes its subgrids touch but it doesn't own
+    int d = ndims-1;                    // the slowest dim
+    BIGINT P = N/Ns;                    // # U pts per plane
+    BIGINT nhalo = 0;                   // total # halo planes
+    for (int t=0; t<nt; ++t) {
+      BIGINT lo = sp->tileplane[t], hi = sp->tileplane[t+1];   // owned planes
+      BIGINT tlo = lo, thi = lo-1;      // (unwrapped) range touched
+      for (int isub=sp->tilesub[t]; isub<sp->tilesub[t+1]; ++isub) {
+        BIGINT *g = sp->subgrid + 6*isub;
+        tlo = min(tlo,g[d]);
+        thi = max(thi,g[d]+g[3+d]-1);
+      }
+      BIGINT *h = sp->halo + 4*t;
+      h[0] = tlo;
+      h[1] = lo-tlo;                    // lower halo is [tlo,lo)
+      h[2] = max((BIGINT)0,thi+1-hi);   // upper halo is [hi,thi]
+      h[3] = 2*P*nhalo;
+      nhalo += h[1]+h[2];
+    }
+    sp->halostride = 2*P*nhalo;         // FLTs per vector's set of halos
+    sp->halobuf = (FLT*)alloc_aligned(sizeof(FLT)*sp->halostride*sp->nvec, ARENA_ALIGN);
+    if (!sp->halobuf) {
+      fprintf(stderr,"%s failed to allocate tile halos (%lld planes)!\n",__func__,(long long)nhalo);
+      destroy_spread_plan(sp);
+      return ERR_SPREAD_ALLOC;
+    }
+    if (opts.debug)
+      printf("\t%d tiles own %lld planes, with %lld halo planes (%.3g GB)\n",nt,(long long)Ns,(long long)nhalo,(double)1e-9*sizeof(FLT)*sp->halostride*sp->nvec);
+  }
+  if (opts.debug)
+    printf("\tspread plan (%d subprobs, max M0=%lld, max subgrid=%lld, nvec=%d), arena %.3g GB:\t%.3g s\n",nb,(long long)maxM0,(long long)maxsize,sp->nvec,(double)1e-9*sizeof(FLT)*sp->nslots*sp->slotsize,timer.elapsedsec());
+  *spp = sp;
+  return 0;
+}
+
+void destroy_spread_plan(SPREAD_PLAN *sp)
+// Frees a plan made by setup_spread_plan. NULL is allowed (does nothing).
+{
+  if (!sp) return;
+  free(sp->brk);
+  free(sp->subgrid);
+  free(sp->order);
+  free_aligned(sp->arena);
+  free(sp->tilesub);
+  free(sp->tileplane);
+  free(sp->halo);
+  free_aligned(sp->halobuf);
+  free(sp);
+}
+
+double KER_CACHE_BYTES(BIGINT M, int ndims, spread_opts opts)
+// RAM that setup_ker_cache would need for M NU pts in ndims dims.
+{
+  return (double)M*ndims*(sizeof(BIGINT) + opts.nspread*sizeof(FLT));
+}
+
+template <class I>
+int setup_ker_cache(KER_CACHE **kcp, I* sort_indices, BIGINT N1,
+                    BIGINT N2, BIGINT N3, BIGINT M, FLT *kx, FLT *ky,
+                    FLT *kz, spread_opts opts)
+/* Folds and rescales each NU pt once, and stores, in sorted order (as given
+   by sort_indices), its fine grid start index and its nspread kernel values
+   in each dim, exactly as spreadSorted and interpSorted would compute them,
+   so that they can read these instead. For repeated spreads/interps (in
+   either direction) at fixed NU pts. The caller checks the RAM cost (see
+   ker_cache_bytes) against its budget first.
+   Returns 0, or ERR_SPREAD_ALLOC if allocation failed (then *kcp is NULL).
+   The cache must be freed by destroy_ker_cache.
+*/
+{
+  *kcp = NULL;
+  CNTime timer; timer.start();
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  int ns = opts.nspread;
+  KER_CACHE *kc = (KER_CACHE*)malloc(sizeof(KER_CACHE));
+  if (!kc) {
+    fprintf(stderr,"%s failed to allocate cache struct!\n",__func__);
+    return ERR_SPREAD_ALLOC;
+  }
+  kc->M = M;
+  kc->ndims = ndims;
+  kc->ns = ns;
+  kc->i0 = (BIGINT*)malloc(sizeof(BIGINT)*ndims*M);
+  kc->ker = (FLT*)alloc_aligned(sizeof(FLT)*ndims*ns*M, ARENA_ALIGN);
+  if (!kc->i0 || !kc->ker) {
+    fprintf(stderr,"%s failed to allocate cache (%.3g GB)!\n",__func__,1e-9*KER_CACHE_BYTES(M,ndims,opts));
+    destroy_ker_cache(kc);
+    return ERR_SPREAD_ALLOC;
+  }
+  int nthr = MY_OMP_GET_MAX_THREADS();
+  if (opts.nthreads>0)
+    nthr = min(nthr,opts.nthreads);
+#pragma omp parallel for num_threads(nthr) schedule(static,10000)
+  for (BIGINT i=0; i<M; i++) {
+    FLT x[3];
+    if (opts.sorted_pts) {
+      x[0] = kx[i];
+      if (ndims>1) x[1] = ky[i];
+      if (ndims>2) x[2] = kz[i];
+    } else {
+      BIGINT j = sort_indices[i];
+      x[0] = FOLDRESCALE(kx[j],N1,opts.pirange);
+      if (ndims>1) x[1] = FOLDRESCALE(ky[j],N2,opts.pirange);
+      if (ndims>2) x[2] = FOLDRESCALE(kz[j],N3,opts.pirange);
+    }
+    opts.ker_point(kc->i0 + ndims*i, kc->ker + ndims*ns*i, ndims, x, &opts);
+  }
+  if (opts.debug)
+    printf("\tkernel cache (%.3g GB):\t%.3g s\n",1e-9*KER_CACHE_BYTES(M,ndims,opts),timer.elapsedsec());
+  *kcp = kc;
+  return 0;
+}
+
+void destroy_ker_cache(KER_CACHE *kc)
+// Frees a cache made by setup_ker_cache. NULL is allowed (does nothing).
+{
+  if (!kc) return;
+  free(kc->i0);
+  free_aligned(kc->ker);
+  free(kc);
+}
+
+void wrap_ghosts(FLT *data_uniform, BIGINT N1, BIGINT N2, BIGINT N3, int nvec,
+                 const spread_opts &opts)
+/* Makes the opts.ghost ghost pts per side of nvec grids (each N1*N2*N3 plus
+   ghosts, see ghost_dims, one after another in data_uniform) consistent with
+   periodicity. If opts.spread_direction=1, folds: adds each ghost pt onto
+   the grid pt of which it is a periodic image, as needed after spreading with
+   ghosts (the ghosts are then stale). If 2, fills: copies each grid pt onto
+   its ghost images, as needed before interpolating with ghosts. Done one dim
+   at a time, x first, each step acting on whole rows (planes) including the
+   ghosts of faster dims. Needs opts.ghost <= N in each used dim.
+   Does nothing if opts.ghost=0.
+*/
+{
+  int g = opts.ghost;
+  if (g==0)
+    return;
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  int nthr = MY_OMP_GET_MAX_THREADS();
+  if (opts.nthreads>0)
+    nthr = min(nthr,opts.nthreads);
+  bool fold = (opts.spread_direction==1);
+  BIGINT P[3], Ns[3] = {N1,N2,N3};
+  ghost_dims(P,N1,N2,N3,g);
+  for (int d=0; d<ndims; d++) {
+    BIGINT s = 1, nlines = nvec;     // # pts per line element, # lines along d
+    for (int e=0; e<d; e++) s *= P[e];
+    for (int e=d+1; e<3; e++) nlines *= P[e];
+    BIGINT n = Ns[d];
+#pragma omp parallel for num_threads(nthr) schedule(static)
+    for (BIGINT l=0; l<nlines; l++) {
+      FLT *line = data_uniform + 2*s*P[d]*l;
+      for (int k=0; k<g; k++) {
+        FLT *lo = line + 2*s*k, *loim = line + 2*s*(n+k);   // ghost, its image
+        FLT *hi = line + 2*s*(g+n+k), *hiim = line + 2*s*(g+k);
+        if (fold)
+          for (BIGINT i=0; i<2*s; i++) {
+            loim[i] += lo[i];
+            hiim[i] += hi[i];
+          }
+        else
+          for (BIGINT i=0; i<2*s; i++) {
+            lo[i] = loim[i];
+            hi[i] = hiim[i];
+          }
+      }
+    }
+  }
+}
+
+
+template <class I>
+int spreadinterpSorted(I* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, 
 		      FLT *data_uniform, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-		      FLT *data_nonuniform, spread_opts opts, int did_sort)
+		      FLT *data_nonuniform, spread_opts opts, int did_sort,
+                       SPREAD_PLAN *sp, int slot0, int nvec, KER_CACHE *kc)
 /* Logic to select the main spreading (dir=1) vs interpolation (dir=2) routine.
-   See spreadinterp() above for inputs arguments and definitions.
-   Return value should always be 0 (no error reporting).
+   See spreadinterp() above for inputs arguments and definitions, and
+   spreadSorted (or interpSorted) for sp, slot0 and nvec, the number
+   of strength vectors (and grids) at the same NU pts, stored one after another
+   in data_nonuniform (and data_uniform). kc is the kernel cache of these
+   sorted NU pts from setup_ker_cache, or NULL to evaluate kernels here.
+   Returns 0, or an error code only if a plan had to be allocated.
    Split out by Melody Shih, Jun 2018; renamed Barnett 5/20/20.
 */
 {
+  int ier = 0;
   if (opts.spread_direction==1)  // ========= direction 1 (spreading) =======
-    spreadSorted(sort_indices, N1, N2, N3, data_uniform, M, kx, ky, kz, data_nonuniform, opts, did_sort);
+    ier = spreadSorted(sort_indices, N1, N2, N3, data_uniform, M, kx, ky, kz, data_nonuniform, opts, did_sort, sp, slot0, nvec, kc);
   
   else           // ================= direction 2 (interpolation) ===========
-    interpSorted(sort_indices, N1, N2, N3, data_uniform, M, kx, ky, kz, data_nonuniform, opts, did_sort);
+    ier = interpSorted(sort_indices, N1, N2, N3, data_uniform, M, kx, ky, kz, data_nonuniform, opts, did_sort, sp, slot0, nvec, kc);
   
-  return 0;
+  return ier;
 }
 
 
 // --------------------------------------------------------------------------
-int spreadSorted(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
+template <class I>
+static FLT* spread_subproblem_in_slot(int isub, FLT *slot, SPREAD_PLAN *sp,
+                                      I* sort_indices, BIGINT N1,
+                                      BIGINT N2, BIGINT N3, BIGINT M,
+                                      FLT *kx, FLT *ky, FLT *kz,
+                                      FLT *data_nonuniform, int nvec,
+                                      KER_CACHE *kc, const spread_opts& opts)
+/* Copies the folded NU pts and strengths of subproblem isub of plan sp into
+   the arena slot, and spreads them to its subgrid, also in the slot.
+   With nvec (<=sp->nvec) strength vectors (each of length M, one after
+   another in data_nonuniform), the NU pts are folded and their kernels
+   evaluated once, and spread to nvec subgrids, one after another.
+   If kernel cache kc is not NULL, the NU pts are not copied at all, and the
+   cached start indices and kernel values of the subproblem are used. Nor are
+   they if opts.sorted_pts, since the subproblem's pts are then contiguous.
+   If opts.sorted_io and nvec=1, the strengths are likewise not copied.
+   Returns a ptr to the first subgrid (its offsets and sizes are in the plan).
+   Helper for spreadSorted.
+*/
+{
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  BIGINT M0 = sp->brk[isub+1]-sp->brk[isub];  // # NU pts in this subprob
+  // this worker's arena slot holds NU pt copies and the subgrid...
+  FLT *kx0 = slot;
+  FLT *ky0 = kx0 + arena_pad(sp->maxM0);   // (only used if N2>1)
+  FLT *kz0 = ky0 + (N2>1 ? arena_pad(sp->maxM0) : 0);  // (if N3>1)
+  FLT *dd0 = kz0 + (N3>1 ? arena_pad(sp->maxM0) : 0);  // complex strengths
+  FLT *du0 = dd0 + arena_pad(2*sp->maxM0*sp->nvec);  // complex subgrids
+  bool ddinplace = opts.sorted_io && nvec==1;  // strengths contiguous already
+  if (ddinplace)
+    dd0 = data_nonuniform + 2*sp->brk[isub];
+  bool ptscopy = !kc && !opts.sorted_pts;
+  // copy the location and data vectors for the nonuniform points
+  for (BIGINT j=0; j<M0 && (ptscopy || !ddinplace); j++) {
+    BIGINT kk=sort_indices[j+sp->brk[isub]];  // NU pt from subprob index list
+    if (ptscopy) {
+      kx0[j]=FOLDRESCALE(kx[kk],N1,opts.pirange);
+      if (N2>1) ky0[j]=FOLDRESCALE(ky[kk],N2,opts.pirange);
+      if (N3>1) kz0[j]=FOLDRESCALE(kz[kk],N3,opts.pirange);
+    }
+    if (ddinplace) continue;
+    BIGINT kd = opts.sorted_io ? j+sp->brk[isub] : kk;   // its strength index
+    for (int v=0; v<nvec; v++) {
+      dd0[2*(M0*v+j)]=data_nonuniform[2*(M*v+kd)];     // real part
+      dd0[2*(M0*v+j)+1]=data_nonuniform[2*(M*v+kd)+1]; // imag part
+    }
+  }
+  // the subgrid (including padding by roughly nspread/2) is in the plan
+  BIGINT *g = sp->subgrid + 6*isub;
+  BIGINT offset1=g[0], offset2=g[1], offset3=g[2];
+  BIGINT size1=g[3], size2=g[4], size3=g[5];
+  if (opts.debug>1) { // verbose
+    if (ndims==1)
+      printf("\tsubgrid: off %lld\t siz %lld\t #NU %lld\n",(long long)offset1,(long long)size1,(long long)M0);
+    else if (ndims==2)
+      printf("\tsubgrid: off %lld,%lld\t siz %lld,%lld\t #NU %lld\n",(long long)offset1,(long long)offset2,(long long)size1,(long long)size2,(long long)M0);
+    else
+      printf("\tsubgrid: off %lld,%lld,%lld\t siz %lld,%lld,%lld\t #NU %lld\n",(long long)offset1,(long long)offset2,(long long)offset3,(long long)size1,(long long)size2,(long long)size3,(long long)M0);
+  }
+  
+  // Spread to subgrid without need for bounds checking or wrapping
+  if (opts.sorted_pts) {              // already folded, in sorted order
+    kx0 = kx + sp->brk[isub];
+    ky0 = (N2>1) ? ky + sp->brk[isub] : NULL;
+    kz0 = (N3>1) ? kz + sp->brk[isub] : NULL;
+  }
+  BIGINT *i0 = kc ? kc->i0 + ndims*sp->brk[isub] : NULL;
+  FLT *kv = kc ? kc->ker + ndims*kc->ns*sp->brk[isub] : NULL;
+  if (!(opts.flags & TF_OMIT_SPREADING))
+    opts.spread_subprob[ndims-1](g,g+3,du0,M0,kx0,ky0,kz0,dd0,nvec,i0,kv,&opts);
+  return du0;
+}
+
+static void add_subgrid_to_tile(SPREAD_PLAN *sp, int t, BIGINT *g, FLT *du0,
+                                FLT *data_uniform, BIGINT N1, BIGINT N2,
+                                BIGINT N3, int v)
+/* Owner-computes version of add_wrapped_subgrid, for a subgrid du0 (offsets
+   and sizes g) of tile t of plan sp. Each plane (in the slowest dim) of the
+   subgrid is added straight to data_uniform if tile t owns it, otherwise to
+   t's halo buffer, for its owner to merge later. Thus no other thread writes
+   the same memory, and no OMP critical or atomic is needed.
+   v is the index of the strength vector (hence of the set of halos) in a
+   fused batch; data_uniform is its grid.
+*/
+{
+  int d = ndims_from_Ns(N1,N2,N3)-1;    // the slowest dim
+  BIGINT Ns = (d==0) ? N1 : ((d==1) ? N2 : N3);
+  BIGINT P = N1*N2*N3/Ns;               // # U pts per plane
+  // offsets, sizes and grid sizes within a plane (1D has 1-pt planes)...
+  BIGINT off1 = (d>0) ? g[0] : 0, off2 = (d>1) ? g[1] : 0;
+  BIGINT size1 = (d>0) ? g[3] : 1, size2 = (d>1) ? g[4] : 1;
+  BIGINT n1 = (d>0) ? N1 : 1, n2 = (d>1) ? N2 : 1;
+  BIGINT lo = sp->tileplane[t], hi = sp->tileplane[t+1];   // owned planes
+  BIGINT *h = sp->halo + 4*t;
+  FLT *hb = sp->halobuf + sp->halostride*v + h[3];   // this tile's halo planes
+  for (BIGINT s=0; s<g[3+d]; s++) {
+    BIGINT z = g[d]+s, zw = z;          // unwrapped, wrapped plane index
+    if (zw<0) zw+=Ns;
+    if (zw>=Ns) zw-=Ns;
+    FLT *out;
+    if (zw>=lo && zw<hi)                // own plane
+      out = data_uniform + 2*P*zw;
+    else if (z<lo)                      // lower halo
+      out = hb + 2*P*(z-h[0]);
+    else                                // upper halo
+      out = hb + 2*P*(h[1]+z-hi);
+    add_wrapped_subgrid(off1,off2,0,size1,size2,1,n1,n2,1,out,du0+2*size1*size2*s);
+  }
+}
+
+static void merge_halos_into_tile(SPREAD_PLAN *sp, int t, FLT *data_uniform,
+                                  BIGINT Ns, BIGINT P, int v)
+/* Adds into the planes of data_uniform owned by tile t those halo planes of
+   the other tiles that (after periodic wrapping) land there. Writes only to
+   t's planes, so all tiles may be merged in parallel, once all spreading to
+   halos is done. Ns is the slowest-dim size, P the # U pts per plane, v the
+   index of the vector in a fused batch (data_uniform is its grid).
+*/
+{
+  BIGINT lo = sp->tileplane[t], hi = sp->tileplane[t+1];   // owned planes
+  for (int u=0; u<sp->ntiles; u++) {
+    if (u==t) continue;
+    BIGINT *h = sp->halo + 4*u;
+    for (BIGINT s=0; s<h[1]+h[2]; s++) {
+      BIGINT z = (s<h[1]) ? h[0]+s : sp->tileplane[u+1]+s-h[1];  // unwrapped
+      if (z<0) z+=Ns;
+      if (z>=Ns) z-=Ns;
+      if (z<lo || z>=hi) continue;
+      FLT *out = data_uniform + 2*P*z;
+      FLT *in = sp->halobuf + sp->halostride*v + h[3] + 2*P*s;
+      for (BIGINT i=0; i<2*P; i++)
+        out[i] += in[i];
+    }
+  }
+}
+
+template <class I>
+int spreadSorted(I* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
 		      FLT *data_uniform,BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-		      FLT *data_nonuniform, spread_opts opts, int did_sort)
-// Spread NU pts in sorted order to a uniform grid. See spreadinterp() for doc.
+		      FLT *data_nonuniform, spread_opts opts, int did_sort,
+                 SPREAD_PLAN *sp, int slot0, int nvec, KER_CACHE *kc)
+/* Spread NU pts in sorted order to a uniform grid. See spreadinterp() for doc.
+   sp is the spread plan for these NU pts from setup_spread_plan; each thread
+   works in its own arena slot, from slot0 upwards (slot0 lets concurrent
+   single-thread calls share one plan), and # threads is capped to fit.
+   If sp is NULL, a temporary plan is made here.
+   nvec is the # of strength vectors (each length M, one after another in
+   data_nonuniform) to spread to as many grids (each N1*N2*N3, one after
+   another in data_uniform). They are fused: each NU pt is folded, and its
+   kernel evaluated, once for all vectors, up to sp->nvec vectors at a time.
+   kc, if not NULL, is the kernel cache of these sorted NU pts (setup_ker_cache),
+   from which the folded pts' kernel values are read rather than evaluated.
+   If the plan has tiles and >1 thread is used, owner-computes spreading is
+   done (tile halo buffers are not per-slot, so single-thread calls, which
+   may be concurrent, instead add subgrids as usual).
+   If opts.method=3, or it is 0 and one thread is used (unless 3D and dense)
+   or the NU pts are sparse (see below), they are instead spread by one thread
+   directly to the output grid with periodic wrapping, in chunks as in
+   interpSorted (fusing up to MAX_CHUNK_NVEC vectors), with no subgrids (or
+   plan) at all.
+   If opts.ghost>0, each output grid carries that many ghost pts per side (see
+   ghost_dims), and subgrids or chunks are added to it with no wrapping; the
+   caller must then fold in the ghosts (wrap_ghosts). Tiles are not used.
+   Returns 0, or ERR_SPREAD_ALLOC if a temporary plan could not be made.
+*/
 {
   CNTime timer;
   int ndims = ndims_from_Ns(N1,N2,N3);
-  BIGINT N=N1*N2*N3;            // output array size
-  int ns=opts.nspread;          // abbrev. for w, kernel width
+  BIGINT N=N1*N2*N3;            // output grid size
+  BIGINT gdims[3];              // output array sizes, incl any ghosts
+  BIGINT goff = ghost_dims(gdims,N1,N2,N3,opts.ghost);  // index of pt (0,0,0)
+  BIGINT Ng = gdims[0]*gdims[1]*gdims[2];   // output array size
   int nthr = MY_OMP_GET_MAX_THREADS();  // # threads to use to spread
   if (opts.nthreads>0)
     nthr = min(nthr,opts.nthreads);     // user override up to max avail
   if (opts.debug)
     printf("\tspread %dD (M=%lld; N1=%lld,N2=%lld,N3=%lld; pir=%d), nthr=%d\n",ndims,(long long)M,(long long)N1,(long long)N2,(long long)N3,opts.pirange,nthr);
-  
-  timer.start();
-  for (BIGINT i=0; i<2*N; i++) // zero the output array. std::fill is no faster
-    data_uniform[i]=0.0;
-  if (opts.debug) printf("\tzero output array\t%.3g s\n",timer.elapsedsec());
+
+  // Direct spreading beats subproblems on one thread, since it needs no subgrid
+  // zeroing or adding, except in 3D above about 1 NU pt per 4 U pts, and at
+  // low density, where subgrids are mostly empty. (Crossovers from
+  // perftest/spreadtestnd.sh, method 1 vs 3.)
+  int direct = (opts.method==3) || (opts.method==0 &&
+    ((nthr==1 && (ndims<3 || 4*M<N)) || M*DIRECT_SPREAD_DENSITY<N));
+  if (sp && !direct)
+    nthr = max(1,min(nthr, sp->nslots-slot0));  // one arena slot per thread
+
+  SPREAD_PLAN *tmpsp = NULL;    // make own plan if none given
+  if (!sp && M>0 && !direct) {
+    int ier = setup_spread_plan(&tmpsp, sort_indices, N1,N2,N3, M, kx,ky,kz,
+                                opts, did_sort, nthr, nvec);
+    if (ier) return ier;
+    sp = tmpsp;
+    slot0 = 0;
+  }
+  if (sp && !direct && nvec>sp->nvec) {   // more vectors than plan fits: groups
+    for (int v0=0; v0<nvec; v0+=sp->nvec)
+      spreadSorted(sort_indices, N1,N2,N3, data_uniform + 2*Ng*v0, M, kx,ky,kz,
+                   data_nonuniform + 2*M*v0, opts, did_sort, sp, slot0,
+                   min(sp->nvec,nvec-v0), kc);
+    return 0;
+  }
+  if (direct && nvec>MAX_CHUNK_NVEC) {    // more than chunks fit: groups
+    for (int v0=0; v0<nvec; v0+=MAX_CHUNK_NVEC)
+      spreadSorted(sort_indices, N1,N2,N3, data_uniform + 2*Ng*v0, M, kx,ky,kz,
+                   data_nonuniform + 2*M*v0, opts, did_sort, sp, slot0,
+                   min(MAX_CHUNK_NVEC,nvec-v0), kc);
+    return 0;
+  }
+  int tiled = (M>0 && !direct && sp->ntiles>0 && nthr>1 && !opts.ghost);  // owner-computes?
+
+  if (!tiled) {     // (tiles zero their own part of the output)
+    // zero the output array(s), each in static contiguous blocks so that first
+    // touch places pages as do the tiles and numa_slabs (slabs in the slowest
+    // dim) and FFTW threads
+    timer.start();
+#pragma omp parallel num_threads(nthr)
+    for (int v=0; v<nvec; v++) {
+      FLT *du = data_uniform + 2*Ng*v;
+#pragma omp for schedule(static)
+      for (BIGINT i=0; i<2*Ng; i++) // std::fill is no faster
+        du[i]=0.0;
+    }
+    if (opts.debug) printf("\tzero output array\t%.3g s\n",timer.elapsedsec());
+  }
   if (M==0)                     // no NU pts, we're done
     return 0;
   
-  int spread_single = (nthr==1) || (M*100<N);     // low-density heuristic?
-  spread_single = 0;                 // for now
   timer.start();
-  if (spread_single) {    // ------- Basic single-core t1 spreading ------
-    for (BIGINT j=0; j<M; j++) {
-      // *** todo, not urgent
-      // ... (question is: will the index wrapping per NU pt slow it down?)
+  if (direct) {    // ------- Basic single-core t1 spreading, direct to grid ---
+    // Chunks of NU pts in sorted order are gathered (as in interpSorted), then
+    // spread with wrapping; sorted pts and strengths are used in place.
+    const int chunk = 16;
+    FLT xjlist[chunk], yjlist[chunk], zjlist[chunk];
+    FLT inbuf[2*chunk*MAX_CHUNK_NVEC];   // nvec strengths per src
+    bool ininplace = opts.sorted_io && nvec==1;
+    for (BIGINT i=0; i<M; i+=chunk) {
+      int bufsize = (i+chunk > M) ? M-i : chunk;
+      FLT *xj = xjlist, *yj = yjlist, *zj = zjlist;
+      if (opts.sorted_pts) {
+        xj = kx+i;
+        if (ndims>=2) yj = ky+i;
+        if (ndims==3) zj = kz+i;
+      }
+      for (int ibuf=0; ibuf<bufsize; ibuf++) {
+        BIGINT j = sort_indices[i+ibuf];
+        if (!kc && !opts.sorted_pts) {
+          xjlist[ibuf] = FOLDRESCALE(kx[j],N1,opts.pirange);
+          if (ndims>=2) yjlist[ibuf] = FOLDRESCALE(ky[j],N2,opts.pirange);
+          if (ndims==3) zjlist[ibuf] = FOLDRESCALE(kz[j],N3,opts.pirange);
+        }
+        if (ininplace) continue;
+        BIGINT jd = opts.sorted_io ? i+ibuf : j;    // strength index
+        for (int v=0; v<nvec; v++) {
+          inbuf[2*(nvec*ibuf+v)] = data_nonuniform[2*(M*v+jd)];
+          inbuf[2*(nvec*ibuf+v)+1] = data_nonuniform[2*(M*v+jd)+1];
+        }
+      }
+      if (!(opts.flags & TF_OMIT_SPREADING))
+        opts.spread_chunk[ndims-1](data_uniform,bufsize,xj,yj,zj,
+                                   ininplace ? data_nonuniform+2*i : inbuf,
+                                   N1,N2,N3,nvec,
+                                   kc ? kc->i0 + ndims*i : NULL,
+                                   kc ? kc->ker + ndims*kc->ns*i : NULL, &opts);
     }
-    if (opts.debug) printf("\tt1 simple spreading:\t%.3g s\n",timer.elapsedsec());
+    if (opts.debug) printf("\tt1 direct spread: \t%.3g s\n",timer.elapsedsec());
     
+  } else if (tiled) {  // ------- Owner-computes tiled t1 spreading ---------
+    // Phase 1: each tile's thread zeros the planes it owns and its halo, then
+    // spreads its subprobs. Phase 2 (after the barrier): each tile's thread
+    // adds into its own planes the halo planes of other tiles landing there.
+    int nt = sp->ntiles;
+    BIGINT Ns = (ndims==1) ? N1 : ((ndims==2) ? N2 : N3);  // slowest dim size
+    BIGINT P = N/Ns;                    // # U pts per plane
+#pragma omp parallel num_threads(nthr)
+    {
+      FLT *slot = sp->arena + (slot0+MY_OMP_GET_THREAD_NUM())*sp->slotsize;
+#pragma omp for schedule(static,1)
+      for (int t=0; t<nt; t++) {
+        BIGINT *h = sp->halo + 4*t;
+        for (int v=0; v<nvec; v++) {
+          FLT *own = data_uniform + 2*N*v + 2*P*sp->tileplane[t];
+          for (BIGINT i=0; i<2*P*(sp->tileplane[t+1]-sp->tileplane[t]); i++)
+            own[i]=0.0;
+          FLT *hb = sp->halobuf + sp->halostride*v + h[3];
+          for (BIGINT i=0; i<2*P*(h[1]+h[2]); i++)
+            hb[i]=0.0;
+        }
+        for (int isub=sp->tilesub[t]; isub<sp->tilesub[t+1]; isub++) {
+          FLT *du0 = spread_subproblem_in_slot(isub, slot, sp, sort_indices, N1, N2, N3, M, kx, ky, kz, data_nonuniform, nvec, kc, opts);
+          BIGINT *g = sp->subgrid + 6*isub;
+          if (!(opts.flags & TF_OMIT_WRITE_TO_GRID))
+            for (int v=0; v<nvec; v++)
+              add_subgrid_to_tile(sp, t, g, du0 + 2*g[3]*g[4]*g[5]*v, data_uniform + 2*N*v, N1, N2, N3, v);
+        }
+      }         // (implicit barrier: all halos are done)
+#pragma omp for schedule(static,1)
+      for (int t=0; t<nt; t++)
+        for (int v=0; v<nvec; v++)
+          merge_halos_into_tile(sp, t, data_uniform + 2*N*v, Ns, P, v);
+    }
+    if (opts.debug) printf("\tt1 tiled spread: \t%.3g s (%d tiles, %d subprobs)\n",timer.elapsedsec(), nt, sp->nb);
+
   } else {           // ------- Fancy multi-core blocked t1 spreading ----
                      // Splits sorted inds (jfm's advanced2), could double RAM.
-    // choose nb (# subprobs) via used nthreads:
-    int nb = min((BIGINT)nthr,M);         // simply split one subprob per thr...
-    if (nb*(BIGINT)opts.max_subproblem_size<M) {  // ...or more subprobs to cap size
-      nb = 1 + (M-1)/opts.max_subproblem_size;  // int div does ceil(M/opts.max_subproblem_size)
-      if (opts.debug) printf("\tcapping subproblem sizes to max of %d\n",opts.max_subproblem_size);
-    }
-    if (M*1000<N) {         // low-density heuristic: one thread per NU pt!
-      nb = M;
-      if (opts.debug) printf("\tusing low-density speed rescue nb=M...\n");
-    }
-    if (!did_sort && nthr==1) {
-      nb = 1;
-      if (opts.debug) printf("\tunsorted nthr=1: forcing single subproblem...\n");
-    }
+    int nb = sp->nb;     // # subprobs and their breakpoints chosen in plan
     if (opts.debug && nthr>opts.atomic_threshold)
       printf("\tnthr big: switching add_wrapped OMP from critical to atomic (!)\n");
-      
-    std::vector<BIGINT> brk(nb+1); // NU index breakpoints defining nb subproblems
-    for (int p=0;p<=nb;++p)
-      brk[p] = (BIGINT)(0.5 + M*p/(double)nb);
-    
-#pragma omp parallel for num_threads(nthr) schedule(dynamic,1)  // each is big
-      for (int isub=0; isub<nb; isub++) {   // Main loop through the subproblems
-        BIGINT M0 = brk[isub+1]-brk[isub];  // # NU pts in this subproblem
-        // copy the location and data vectors for the nonuniform points
-        FLT *kx0=(FLT*)malloc(sizeof(FLT)*M0), *ky0=NULL, *kz0=NULL;
-        if (N2>1)
-          ky0=(FLT*)malloc(sizeof(FLT)*M0);
-        if (N3>1)
-          kz0=(FLT*)malloc(sizeof(FLT)*M0);
-        FLT *dd0=(FLT*)malloc(sizeof(FLT)*M0*2);    // complex strength data
-        for (BIGINT j=0; j<M0; j++) {           // todo: can avoid this copying?
-          BIGINT kk=sort_indices[j+brk[isub]];  // NU pt from subprob index list
-          kx0[j]=FOLDRESCALE(kx[kk],N1,opts.pirange);
-          if (N2>1) ky0[j]=FOLDRESCALE(ky[kk],N2,opts.pirange);
-          if (N3>1) kz0[j]=FOLDRESCALE(kz[kk],N3,opts.pirange);
-          dd0[j*2]=data_nonuniform[kk*2];     // real part
-          dd0[j*2+1]=data_nonuniform[kk*2+1]; // imag part
-        }
-        // get the subgrid which will include padding by roughly nspread/2
-        BIGINT offset1,offset2,offset3,size1,size2,size3; // get_subgrid sets
-        get_subgrid(offset1,offset2,offset3,size1,size2,size3,M0,kx0,ky0,kz0,ns,ndims);  // sets offsets and sizes
-        if (opts.debug>1) { // verbose
-          if (ndims==1)
-            printf("\tsubgrid: off %lld\t siz %lld\t #NU %lld\n",(long long)offset1,(long long)size1,(long long)M0);
-          else if (ndims==2)
-            printf("\tsubgrid: off %lld,%lld\t siz %lld,%lld\t #NU %lld\n",(long long)offset1,(long long)offset2,(long long)size1,(long long)size2,(long long)M0);
-          else
-            printf("\tsubgrid: off %lld,%lld,%lld\t siz %lld,%lld,%lld\t #NU %lld\n",(long long)offset1,(long long)offset2,(long long)offset3,(long long)size1,(long long)size2,(long long)size3,(long long)M0);
-	}
-        // allocate output data for this subgrid
-        FLT *du0=(FLT*)malloc(sizeof(FLT)*2*size1*size2*size3); // complex
-        
-        // Spread to subgrid without need for bounds checking or wrapping
-        if (!(opts.flags & TF_OMIT_SPREADING)) {
-          if (ndims==1)
-            spread_subproblem_1d(offset1,size1,du0,M0,kx0,dd0,opts);
-          else if (ndims==2)
-            spread_subproblem_2d(offset1,offset2,size1,size2,du0,M0,kx0,ky0,dd0,opts);
-          else
-            spread_subproblem_3d(offset1,offset2,offset3,size1,size2,size3,du0,M0,kx0,ky0,kz0,dd0,opts);
-	}
+    std::vector<int> kb;        // slab-local subprob ranges (opts.numa=2)
+    if (opts.numa==2 && did_sort && nthr>1 && opts.bin_order==0) {
+      std::vector<BIGINT> jb;
+      numa_slabs(jb,nthr,sort_indices,N1,N2,N3,M,kx,ky,kz,opts);
+      kb.resize(nthr+1);        // 1st subprob starting at or after each break
+      for (int t=0; t<=nthr; t++)
+        kb[t] = std::lower_bound(sp->brk,sp->brk+nb,jb[t]) - sp->brk;
+    }
+
+    auto do_subprob = [&](int isub) {   // spread one subprob and add it in
+        FLT *slot = sp->arena + (slot0+MY_OMP_GET_THREAD_NUM())*sp->slotsize;
+        FLT *du0 = spread_subproblem_in_slot(isub, slot, sp, sort_indices, N1, N2, N3, M, kx, ky, kz, data_nonuniform, nvec, kc, opts);
+        BIGINT *g = sp->subgrid + 6*isub;
+        BIGINT offset1=g[0], offset2=g[1], offset3=g[2];
+        BIGINT size1=g[3], size2=g[4], size3=g[5];
+        BIGINT gs = 2*size1*size2*size3;    // FLTs per subgrid
         
-        // do the adding of subgrid to output
+        // do the adding of subgrid(s) to output
         if (!(opts.flags & TF_OMIT_WRITE_TO_GRID)) {
-          if (nthr > opts.atomic_threshold)   // see above for debug reporting
-            add_wrapped_subgrid_thread_safe(offset1,offset2,offset3,size1,size2,size3,N1,N2,N3,data_uniform,du0);   // R Blackwell's atomic version
+          if (opts.ghost) {                   // no wrapping, contiguous rows
+            bool atomic = nthr > opts.atomic_threshold;
+            if (atomic)
+              for (int v=0; v<nvec; v++)
+                add_subgrid_ghost(g,gdims,data_uniform+2*(Ng*v+goff),du0+gs*v,true);
+            else {
+#pragma omp critical
+              for (int v=0; v<nvec; v++)
+                add_subgrid_ghost(g,gdims,data_uniform+2*(Ng*v+goff),du0+gs*v,false);
+            }
+          } else if (nthr > opts.atomic_threshold)   // see above for debug reporting
+            for (int v=0; v<nvec; v++)
+              add_wrapped_subgrid_thread_safe(offset1,offset2,offset3,size1,size2,size3,N1,N2,N3,data_uniform+2*N*v,du0+gs*v);   // R Blackwell's atomic version
           else {
 #pragma omp critical
-            add_wrapped_subgrid(offset1,offset2,offset3,size1,size2,size3,N1,N2,N3,data_uniform,du0);
+            for (int v=0; v<nvec; v++)
+              add_wrapped_subgrid(offset1,offset2,offset3,size1,size2,size3,N1,N2,N3,data_uniform+2*N*v,du0+gs*v);
           }
         }
+      };
 
-        // free up stuff from this subprob... (that was malloc'ed by hand)
-        free(dd0);
-        free(du0);
-        free(kx0);
-        if (N2>1) free(ky0);
-        if (N3>1) free(kz0); 
-      }     // end main loop over subprobs
+    if (kb.empty()) {
+#pragma omp parallel for num_threads(nthr) schedule(dynamic,1)  // each is big
+      for (int k=0; k<nb; k++)     // Main loop through the subproblems
+        do_subprob(sp->order[k]);  // (costliest first, if opts.balance)
+    } else {
+#pragma omp parallel for num_threads(nthr) schedule(static,1)
+      for (int t=0; t<nthr; t++)   // each slab's subprobs, in grid order
+        for (int isub=kb[t]; isub<kb[t+1]; isub++)
+          do_subprob(isub);
+    }
       if (opts.debug) printf("\tt1 fancy spread: \t%.3g s (%d subprobs)\n",timer.elapsedsec(), nb);
     }   // end of choice of which t1 spread type to use
+    destroy_spread_plan(tmpsp);
     return 0;
 };
 
 
 // --------------------------------------------------------------------------
-int interpSorted(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
+template <class I>
+int interpSorted(I* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
 		      FLT *data_uniform,BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-		      FLT *data_nonuniform, spread_opts opts, int did_sort)
+		      FLT *data_nonuniform, spread_opts opts, int did_sort,
+                 SPREAD_PLAN *sp, int slot0, int nvec, KER_CACHE *kc)
 // Interpolate to NU pts in sorted order from a uniform grid.
 // See spreadinterp() for doc.
+// nvec grids (each N1*N2*N3, one after another in data_uniform) are
+// interpolated to as many output vectors (each length M, one after another in
+// data_nonuniform), fused: each NU pt is folded, and its kernel evaluated,
+// once for all nvec grids, or if nvec>MAX_CHUNK_NVEC for each group of that
+// many (so that the chunk output buffers fit on the stack).
+// If kc is not NULL, the kernel values are read from this cache of the sorted
+// NU pts (see setup_ker_cache) instead, and the pts are not folded.
+// If opts.sorted_io, outputs are written in sorted order (see spread_opts.h),
+// and for nvec=1 straight into data_nonuniform with no buffer.
+// If opts.ghost>0, each grid carries that many ghost pts per side (see
+// ghost_dims), already filled by wrap_ghosts, and is read with no wrapping.
+// If opts.numa=2 and the pts were sorted, each thread instead does the NU pts
+// falling in its own slab of the grid (see numa_slabs).
+// opts.prefetch<0 (auto) is set here to a distance found by spreadtestnd's
+// sweep: stencils are prefetched only for unsorted 3D, where they miss cache.
+// If opts.interp_method=1 and the pts were sorted, the NU pts are instead
+// split into the subprobs of plan sp (made by setup_spread_plan with
+// spread_direction=2; if NULL a temporary one is made here), and each thread
+// copies a subprob's subgrid (capped to fit in L2 cache) into its arena slot
+// (from slot0 on, as in spreadSorted), then interpolates from that, with no
+// wrapping and few cache misses. This is the type 2 analogue of spreading
+// subproblems: each grid pt is read from RAM once per subgrid covering it,
+// rather than once per stencil. Returns 0, or an error code if a temporary
+// plan could not be allocated.
 {
   CNTime timer;
   int ndims = ndims_from_Ns(N1,N2,N3);
-  int ns=opts.nspread;          // abbrev. for w, kernel width
-  FLT ns2 = (FLT)ns/2;          // half spread width, used as stencil shift
+  BIGINT gdims[3];                       // grid array sizes, incl any ghosts
+  BIGINT goff = ghost_dims(gdims,N1,N2,N3,opts.ghost);  // index of pt (0,0,0)
+  BIGINT Ng = gdims[0]*gdims[1]*gdims[2];   // grid array size
   int nthr = MY_OMP_GET_MAX_THREADS();   // # threads to use to interp
   if (opts.nthreads>0)
     nthr = min(nthr,opts.nthreads);      // user override up to max avail
   if (opts.debug)
-    printf("\tinterp %dD (M=%lld; N1=%lld,N2=%lld,N3=%lld; pir=%d), nthr=%d\n",ndims,(long long)M,(long long)N1,(long long)N2,(long long)N3,opts.pirange,nthr);
+    printf("\tinterp %dD (M=%lld; N1=%lld,N2=%lld,N3=%lld; pir=%d), nthr=%d, nvec=%d\n",ndims,(long long)M,(long long)N1,(long long)N2,(long long)N3,opts.pirange,nthr,nvec);
+  if (opts.prefetch<0)    // auto: only 3D unsorted stencils miss cache enough
+    opts.prefetch = (!did_sort && ndims==3) ? 8 : 0;  // (spreadtestnd sweep)
+
+  bool subgrids = (opts.interp_method==1 && did_sort && M>0);
+  SPREAD_PLAN *tmpsp = NULL;             // make own plan if none given
+  if (subgrids) {
+    if (!sp) {
+      spread_opts popts = opts;
+      popts.spread_direction = 2;        // (plan for interp subgrids)
+      int ier = setup_spread_plan(&tmpsp, sort_indices, N1,N2,N3, M, kx,ky,kz,
+                                  popts, did_sort, nthr, nvec);
+      if (ier) return ier;
+      sp = tmpsp;
+      slot0 = 0;
+    }
+    nthr = max(1,min(nthr, sp->nslots-slot0));  // one arena slot per thread
+    if (nvec>sp->nvec) {                 // more grids than plan fits: groups
+      for (int v0=0; v0<nvec; v0+=sp->nvec)
+        interpSorted(sort_indices, N1,N2,N3, data_uniform + 2*Ng*v0, M, kx,ky,kz,
+                     data_nonuniform + 2*M*v0, opts, did_sort, sp, slot0,
+                     min(sp->nvec,nvec-v0), kc);
+      destroy_spread_plan(tmpsp);
+      return 0;
+    }
+  }
+  if (nvec>MAX_CHUNK_NVEC) {             // more grids than chunks fit: groups
+    for (int v0=0; v0<nvec; v0+=MAX_CHUNK_NVEC)
+      interpSorted(sort_indices, N1,N2,N3, data_uniform + 2*Ng*v0, M, kx,ky,kz,
+                   data_nonuniform + 2*M*v0, opts, did_sort, sp, slot0,
+                   min(MAX_CHUNK_NVEC,nvec-v0), kc);
+    destroy_spread_plan(tmpsp);
+    return 0;
+  }
+  spread_opts lopts = opts;              // for reading subgrids: no ghosts,
+  lopts.ghost = 0;                       // and stencils are in cache already
+  lopts.prefetch = 0;
+  std::vector<BIGINT> jb;                // slab-local NU pt ranges, if any
+  std::vector<int> kb;                   // and subprob ranges, if subgrids
+  if (opts.numa==2 && did_sort && nthr>1 && M>0 && opts.bin_order==0) {
+    numa_slabs(jb,nthr,sort_indices,N1,N2,N3,M,kx,ky,kz,opts);
+    if (subgrids) {
+      kb.resize(nthr+1);      // 1st subprob starting at or after each break
+      for (int t=0; t<=nthr; t++)
+        kb[t] = std::lower_bound(sp->brk,sp->brk+sp->nb,jb[t]) - sp->brk;
+    }
+  }
 
   timer.start();  
 #pragma omp parallel num_threads(nthr)
@@ -448,91 +1505,117 @@ int interpSorted(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3,
 #define CHUNKSIZE 16     // Chunks of Type 2 targets (Ludvig found by expt)
     BIGINT jlist[CHUNKSIZE];
     FLT xjlist[CHUNKSIZE], yjlist[CHUNKSIZE], zjlist[CHUNKSIZE];
-    FLT outbuf[2*CHUNKSIZE];
-    // Kernels: static alloc is faster, so we do it for up to 3D...
-    FLT kernel_args[3*MAX_NSPREAD];
-    FLT kernel_values[3*MAX_NSPREAD];
-    FLT *ker1 = kernel_values;
-    FLT *ker2 = kernel_values + ns;
-    FLT *ker3 = kernel_values + 2*ns;       
-
-    // Loop over interpolation chunks
-#pragma omp for schedule (dynamic,1000)  // assign threads to NU targ pts:
-    for (BIGINT i=0; i<M; i+=CHUNKSIZE)  // main loop over NU targs, interp each from U
+    BIGINT i0list[3*CHUNKSIZE];  // cached start indices, relative to subgrid
+    FLT outbuf[2*CHUNKSIZE*MAX_CHUNK_NVEC];   // nvec outputs per targ
+
+    // interp the chunk of bufsize NU targs starting at i in sorted order, from
+    // the grid(s), or if g is not NULL from the copied subgrid(s) du0 with
+    // offsets and sizes g[0..5] (see setup_spread_plan)
+    auto do_chunk = [&](BIGINT i, int bufsize, FLT *du0, BIGINT *g)
       {
+        bool local = (g!=NULL);      // coords relative to the subgrid
+        FLT g1 = local ? (FLT)g[0] : 0, g2 = local ? (FLT)g[1] : 0;
+        FLT g3 = local ? (FLT)g[2] : 0;
         // Setup buffers for this chunk
-        int bufsize = (i+CHUNKSIZE > M) ? M-i : CHUNKSIZE;
         for (int ibuf=0; ibuf<bufsize; ibuf++) {
           BIGINT j = sort_indices[i+ibuf];
-          jlist[ibuf] = j;
-	  xjlist[ibuf] = FOLDRESCALE(kx[j],N1,opts.pirange);
+          jlist[ibuf] = opts.sorted_io ? i+ibuf : j;   // where output goes
+          if (kc) {                  // (no need for coords)
+            if (local)
+              for (int d=0; d<ndims; d++)
+                i0list[ndims*ibuf+d] = kc->i0[ndims*(i+ibuf)+d] - g[d];
+            continue;
+          }
+          if (opts.sorted_pts) {     // (streamed in place below, if not local)
+            if (!local) continue;
+	    xjlist[ibuf] = kx[i+ibuf] - g1;
+	    if(ndims >=2)
+	      yjlist[ibuf] = ky[i+ibuf] - g2;
+	    if(ndims == 3)
+	      zjlist[ibuf] = kz[i+ibuf] - g3;
+            continue;
+          }
+	  xjlist[ibuf] = FOLDRESCALE(kx[j],N1,opts.pirange) - g1;
 	  if(ndims >=2)
-	    yjlist[ibuf] = FOLDRESCALE(ky[j],N2,opts.pirange);
+	    yjlist[ibuf] = FOLDRESCALE(ky[j],N2,opts.pirange) - g2;
 	  if(ndims == 3)
-	    zjlist[ibuf] = FOLDRESCALE(kz[j],N3,opts.pirange);                              
+	    zjlist[ibuf] = FOLDRESCALE(kz[j],N3,opts.pirange) - g3;
 	}
       
-    // Loop over targets in chunk
-    for (int ibuf=0; ibuf<bufsize; ibuf++) {
-      FLT xj = xjlist[ibuf];
-      FLT yj = (ndims > 1) ? yjlist[ibuf] : 0;
-      FLT zj = (ndims > 2) ? zjlist[ibuf] : 0;
-
-      FLT *target = outbuf+2*ibuf;
-        
-      // coords (x,y,z), spread block corner index (i1,i2,i3) of current NU targ
-      BIGINT i1=(BIGINT)std::ceil(xj-ns2); // leftmost grid index
-      BIGINT i2= (ndims > 1) ? (BIGINT)std::ceil(yj-ns2) : 0; // min y grid index
-      BIGINT i3= (ndims > 1) ? (BIGINT)std::ceil(zj-ns2) : 0; // min z grid index
-     
-      FLT x1=(FLT)i1-xj;           // shift of ker center, in [-w/2,-w/2+1]
-      FLT x2= (ndims > 1) ? (FLT)i2-yj : 0 ;
-      FLT x3= (ndims > 2)? (FLT)i3-zj : 0;
-
-      // eval kernel values patch and use to interpolate from uniform data...
-      if (!(opts.flags & TF_OMIT_SPREADING)) {
-
-	  if (opts.kerevalmeth==0) {               // choose eval method
-	    set_kernel_args(kernel_args, x1, opts);
-	    if(ndims > 1)  set_kernel_args(kernel_args+ns, x2, opts);
-	    if(ndims > 2)  set_kernel_args(kernel_args+2*ns, x3, opts);
-	    
-	    evaluate_kernel_vector(kernel_values, kernel_args, opts, ndims*ns);
-	  }
-
-	  else{
-	    eval_kernel_vec_Horner(ker1,x1,ns,opts);
-	    if (ndims > 1) eval_kernel_vec_Horner(ker2,x2,ns,opts);  
-	    if (ndims > 2) eval_kernel_vec_Horner(ker3,x3,ns,opts);
-	  }
-
-	  switch(ndims){
-	  case 1:
-	    interp_line(target,data_uniform,ker1,i1,N1,ns);
-	    break;
-	  case 2:
-	    interp_square(target,data_uniform,ker1,ker2,i1,i2,N1,N2,ns);
-	    break;
-	  case 3:
-	    interp_cube(target,data_uniform,ker1,ker2,ker3,i1,i2,i3,N1,N2,N3,ns);
-	    break;
-	  default: //can't get here
-	    break;
-	     
-	  }	 
-      }
-    } // end loop over targets in chunk
+        // interp targets in chunk, via routine for this ns & ndims
+        FLT *xj = xjlist, *yj = yjlist, *zj = zjlist;
+        if (opts.sorted_pts && !local) {   // stream the chunk's folded coords
+          xj = kx+i;
+          if (ndims>=2) yj = ky+i;
+          if (ndims==3) zj = kz+i;
+        }
+        bool outinplace = opts.sorted_io && nvec==1;
+        if (!(opts.flags & TF_OMIT_SPREADING)) {
+          if (local)
+            opts.interp_chunk[ndims-1](outinplace ? data_nonuniform+2*i : outbuf,
+                                       bufsize,xj,yj,zj,du0,g[3],g[4],g[5],nvec,
+                                       kc ? i0list : NULL,
+                                       kc ? kc->ker + ndims*kc->ns*i : NULL, &lopts);
+          else
+            opts.interp_chunk[ndims-1](outinplace ? data_nonuniform+2*i : outbuf,
+                                       bufsize,xj,yj,zj,data_uniform,N1,N2,N3,nvec,
+                                       kc ? kc->i0 + ndims*i : NULL,
+                                       kc ? kc->ker + ndims*kc->ns*i : NULL, &opts);
+        }
         
-    // Copy result buffer to output array
+    // Copy result buffer to output array(s)
+    if (!outinplace)
     for (int ibuf=0; ibuf<bufsize; ibuf++) {
       BIGINT j = jlist[ibuf];
-      data_nonuniform[2*j] = outbuf[2*ibuf];
-      data_nonuniform[2*j+1] = outbuf[2*ibuf+1];              
+      for (int v=0; v<nvec; v++) {
+        data_nonuniform[2*(M*v+j)] = outbuf[2*(nvec*ibuf+v)];
+        data_nonuniform[2*(M*v+j)+1] = outbuf[2*(nvec*ibuf+v)+1];
+      }
     }         
-        
-      } // end NU targ loop
+      };
+
+    // copy subprob isub's subgrid(s) into this thread's slot, and interp its
+    // NU targs from there
+    auto do_subprob = [&](int isub)
+      {
+        FLT *du0 = sp->arena + (slot0+MY_OMP_GET_THREAD_NUM())*sp->slotsize;
+        BIGINT *g = sp->subgrid + 6*isub;
+        BIGINT gs = 2*g[3]*g[4]*g[5];        // FLTs per subgrid
+        if (!(opts.flags & TF_OMIT_WRITE_TO_GRID))   // (ie, from the grid)
+          for (int v=0; v<nvec; v++)
+            copy_wrapped_subgrid(g,N1,N2,N3,gdims,data_uniform+2*(Ng*v+goff),du0+gs*v);
+        BIGINT iend = sp->brk[isub+1];
+        for (BIGINT i=sp->brk[isub]; i<iend; i+=CHUNKSIZE)
+          do_chunk(i, (i+CHUNKSIZE > iend) ? iend-i : CHUNKSIZE, du0, g);
+      };
+
+    if (subgrids && kb.empty()) {
+#pragma omp for schedule(dynamic,1)      // each subprob is big
+      for (int k=0; k<sp->nb; k++)
+        do_subprob(sp->order[k]);
+    } else if (subgrids) {
+#pragma omp for schedule(static,1)       // thread t does slab t's subprobs
+      for (int t=0; t<nthr; t++)
+        for (int isub=kb[t]; isub<kb[t+1]; isub++)
+          do_subprob(isub);
+    } else if (jb.empty()) {
+#pragma omp for schedule (dynamic,1000)  // assign threads to NU targ pts:
+      for (BIGINT i=0; i<M; i+=CHUNKSIZE)  // main loop over NU targs, interp each from U
+        do_chunk(i, (i+CHUNKSIZE > M) ? M-i : CHUNKSIZE, NULL, NULL);
+    } else {
+#pragma omp for schedule(static,1)       // thread t does slab t's NU pts
+      for (int t=0; t<nthr; t++)
+        for (BIGINT i=jb[t]; i<jb[t+1]; i+=CHUNKSIZE)
+          do_chunk(i, (i+CHUNKSIZE > jb[t+1]) ? jb[t+1]-i : CHUNKSIZE, NULL, NULL);
+    }
   } // end parallel section
-  if (opts.debug) printf("\tt2 spreading loop: \t%.3g s\n",timer.elapsedsec());
+  if (opts.debug) {
+    if (subgrids)
+      printf("\tt2 subgrid interp loop: \t%.3g s (%d subprobs)\n",timer.elapsedsec(),sp->nb);
+    else
+      printf("\tt2 spreading loop: \t%.3g s\n",timer.elapsedsec());
+  }
+  destroy_spread_plan(tmpsp);
   return 0;
 };
 
@@ -574,6 +1657,16 @@ int setup_spreader(spread_opts &opts, FLT eps, double upsampfac,
   // write out default spread_opts (some overridden in setup_spreader_for_nufft)
   opts.spread_direction = 0;    // user should always set to 1 or 2 as desired
   opts.pirange = 1;             // user also should always set this
+  opts.sorted_pts = 0;          // NU pts are the user's, gathered via sort
+  opts.sorted_io = 0;           // and so are their strengths or outputs
+  opts.ghost = 0;               // grids have no ghost pts
+  opts.numa = 0;                // no NUMA-local scheduling
+  opts.prefetch = -1;           // auto-choice of interp stencil prefetch
+  opts.interp_method = 0;       // interp straight from the grid
+  opts.bin_size_x = 0;          // auto sort bin sizes
+  opts.bin_size_y = 0;
+  opts.bin_size_z = 0;
+  opts.bin_order = 0;           // Cartesian bin order
   opts.chkbnds = 0;
   opts.sort = 2;                // 2:auto-choice
   opts.kerpad = 0;              // affects only evaluate_kernel_vector
@@ -587,6 +1680,8 @@ int setup_spreader(spread_opts &opts, FLT eps, double upsampfac,
   opts.debug = 0;               // 0:no debug output
   // heuristic nthr above which switch OMP critical to atomic (add_wrapped...):
   opts.atomic_threshold = 10;   // R Blackwell's value
+  opts.method = 0;              // 0:auto-choice (see spreadSorted)
+  opts.balance = 0;             // equal-count subprobs
 
   int ns, ier = 0;  // Set kernel width w (aka ns, nspread) then copy to opts...
   if (eps<EPSILON) {            // safety; there's no hope of beating e_mach
@@ -608,6 +1703,7 @@ int setup_spreader(spread_opts &opts, FLT eps, double upsampfac,
     ier = WARN_EPS_TOO_SMALL;
   }
   opts.nspread = ns;
+  int isa = set_spread_kernels(opts);   // select routines for this ns, once
 
   // setup for reference kernel eval (via formula): select beta width param...
   // (even when kerevalmeth=1, this ker eval needed for FTs in onedim_*_kernel)
@@ -623,7 +1719,8 @@ int setup_spreader(spread_opts &opts, FLT eps, double upsampfac,
   }
   opts.ES_beta = betaoverns * (FLT)ns;    // set the kernel beta parameter
   if (debug)
-    printf("%s (kerevalmeth=%d) eps=%.3g sigma=%.3g: chose ns=%d beta=%.3g\n",__func__,kerevalmeth,(double)eps,upsampfac,ns,(double)opts.ES_beta);
+    printf("%s (kerevalmeth=%d) eps=%.3g sigma=%.3g: chose ns=%d beta=%.3g, %s kernels\n",__func__,kerevalmeth,(double)eps,upsampfac,ns,(double)opts.ES_beta,
+           isa==SIMD_AVX512 ? "avx512" : (isa==SIMD_AVX2 ? "avx2" : "generic"));
   
   return ier;
 }
@@ -643,16 +1740,16 @@ FLT evaluate_kernel(FLT x, const spread_opts &opts)
     return exp(opts.ES_beta * sqrt(1.0 - opts.ES_c*x*x));
 }
 
-static inline void set_kernel_args(FLT *args, FLT x, const spread_opts& opts)
+template<int ns>
+static SIMD_INLINE void set_kernel_args(FLT *args, FLT x)
 // Fills vector args[] with kernel arguments x, x+1, ..., x+ns-1.
 // needed for the vectorized kernel eval of Ludvig af K.
 {
-  int ns=opts.nspread;
   for (int i=0; i<ns; i++)
     args[i] = x + (FLT) i;
 }
 
-static inline void evaluate_kernel_vector(FLT *ker, FLT *args, const spread_opts& opts, const int N)
+static SIMD_INLINE void evaluate_kernel_vector(FLT *ker, FLT *args, const spread_opts& opts, const int N)
 /* Evaluate ES kernel for a vector of N arguments; by Ludvig af K.
    If opts.kerpad true, args and ker must be allocated for Npad, and args is
    written to (to pad to length Npad), only first N outputs are correct.
@@ -688,12 +1785,15 @@ static inline void evaluate_kernel_vector(FLT *ker, FLT *args, const spread_opts
     if (abs(args[i])>=opts.ES_halfwidth) ker[i] = 0.0;
 }
 
-static inline void eval_kernel_vec_Horner(FLT *ker, const FLT x, const int w,
+template<int w>
+static SIMD_INLINE void eval_kernel_vec_Horner(FLT *ker, const FLT x,
 					  const spread_opts &opts)
 /* Fill ker[] with Horner piecewise poly approx to [-w/2,w/2] ES kernel eval at
    x_j = x + j,  for j=0,..,w-1.  Thus x in [-w/2,-w/2+1].   w is aka ns.
    This is the current evaluation method, since it's faster (except i7 w=16).
-   Two upsampfacs implemented. Params must match ref formula. Barnett 4/24/18 */
+   Two upsampfacs implemented. Params must match ref formula. Barnett 4/24/18
+   w is a template param, so the compiler drops all but one branch of the
+   generated w ladder, and knows the loop lengths. */
 {
   if (!(opts.flags & TF_OMIT_EVALUATE_KERNEL)) {
     FLT z = 2*x + w - 1.0;         // scale so local grid offset z in [-1,1]
@@ -707,7 +1807,60 @@ static inline void eval_kernel_vec_Horner(FLT *ker, const FLT x, const int w,
   }
 }
 
-void interp_line(FLT *target,FLT *du, FLT *ker,BIGINT i1,BIGINT N1,int ns)
+template<int ns>
+static SIMD_INLINE void interp_line_nowrap(FLT *target, FLT *du, FLT *ker)
+// 1D interpolate as in interp_line, but from the ns complex values starting
+// at du, with no wrapping (the stencil lies in the array, eg it has ghosts).
+{
+  FLT out[] = {0.0, 0.0};
+  for (int dx=0; dx<ns; ++dx) {
+    out[0] += du[2*dx]*ker[dx];
+    out[1] += du[2*dx+1]*ker[dx];
+  }
+  target[0] = out[0];
+  target[1] = out[1];
+}
+
+template<int ns, int W>
+static SIMD_INLINE void interp_square_nowrap(FLT *target, FLT *du, FLT *ker1,
+                                             FLT *ker2, BIGINT P1)
+// 2D interpolate as in interp_square, with no wrapping, from the ns*ns square
+// whose lowest corner is at du, in a grid with row length P1. Explicit SIMD
+// (W FLTs per vector) sum of ker2-weighted rows, then a single dot with ker1.
+{
+  FLT line[2*MAX_NSPREAD] = {0};    // y-weighted sum of rows (interleaved)
+  for (int dy=0; dy<ns; dy++)
+    simd_ops<FLT,2*ns,W>::axpy(line, ker2[dy], du+2*P1*dy);
+  FLT out[] = {0.0, 0.0};
+  for (int dx=0; dx<ns; dx++) {
+    out[0] += line[2*dx] * ker1[dx];
+    out[1] += line[2*dx+1] * ker1[dx];
+  }
+  target[0] = out[0];
+  target[1] = out[1];
+}
+
+template<int ns, int W>
+static SIMD_INLINE void interp_cube_nowrap(FLT *target, FLT *du, FLT *ker1,
+                                           FLT *ker2, FLT *ker3, BIGINT P1,
+                                           BIGINT P12)
+// 3D version of interp_square_nowrap; P12 is the grid plane size.
+{
+  FLT line[2*MAX_NSPREAD] = {0};    // yz-weighted sum of rows (interleaved)
+  for (int dz=0; dz<ns; dz++)
+    for (int dy=0; dy<ns; dy++)
+      simd_ops<FLT,2*ns,W>::axpy(line, ker2[dy]*ker3[dz], du+2*(P12*dz+P1*dy));
+  FLT out[] = {0.0, 0.0};
+  for (int dx=0; dx<ns; dx++) {
+    out[0] += line[2*dx] * ker1[dx];
+    out[1] += line[2*dx+1] * ker1[dx];
+  }
+  target[0] = out[0];
+  target[1] = out[1];
+}
+
+template<int ns>
+static SIMD_INLINE void interp_line(FLT *target,FLT *du, FLT *ker,BIGINT i1,BIGINT N1)
 // 1D interpolate complex values from du array to out, using real weights
 // ker[0] through ker[ns-1]. out must be size 2 (real,imag), and du
 // of size 2*N1 (alternating real,imag). i1 is the left-most index in [0,N1)
@@ -753,7 +1906,8 @@ void interp_line(FLT *target,FLT *du, FLT *ker,BIGINT i1,BIGINT N1,int ns)
   target[1] = out[1];
 }
 
-void interp_square(FLT *target,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i2,BIGINT N1,BIGINT N2,int ns)
+template<int ns, int W>
+static SIMD_INLINE void interp_square(FLT *target,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i2,BIGINT N1,BIGINT N2)
 // 2D interpolate complex values from du (uniform grid data) array to out value,
 // using ns*ns square of real weights
 // in ker. out must be size 2 (real,imag), and du
@@ -762,19 +1916,13 @@ void interp_square(FLT *target,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i
 // Periodic wrapping in the du array is applied, assuming N1,N2>=ns.
 // dx,dy indices into ker array, j index in complex du array.
 // Barnett 6/16/17
+// No-wrap case: explicit SIMD (W FLTs per vector) sum of ker2-weighted rows,
+// then a single dot with ker1.
 {
   FLT out[] = {0.0, 0.0};
-  if (i1>=0 && i1+ns<=N1 && i2>=0 && i2+ns<=N2) {  // no wrapping: avoid ptrs
-    for (int dy=0; dy<ns; dy++) {
-      BIGINT j = N1*(i2+dy) + i1;
-      for (int dx=0; dx<ns; dx++) {
-	FLT k = ker1[dx]*ker2[dy];
-	out[0] += du[2*j] * k;
-	out[1] += du[2*j+1] * k;
-	++j;
-      }
-    }
-  } else {                         // wraps somewhere: use ptr list (slower)
+  if (i1>=0 && i1+ns<=N1 && i2>=0 && i2+ns<=N2)    // no wrapping: avoid ptrs
+    interp_square_nowrap<ns,W>(out,du+2*(N1*i2+i1),ker1,ker2,N1);
+  else {                           // wraps somewhere: use ptr list (slower)
     BIGINT j1[MAX_NSPREAD], j2[MAX_NSPREAD];   // 1d ptr lists
     BIGINT x=i1, y=i2;                 // initialize coords
     for (int d=0; d<ns; d++) {         // set up ptr lists
@@ -799,8 +1947,9 @@ void interp_square(FLT *target,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i
   target[1] = out[1];  
 }
 
-void interp_cube(FLT *target,FLT *du, FLT *ker1, FLT *ker2, FLT *ker3,
-		 BIGINT i1,BIGINT i2,BIGINT i3, BIGINT N1,BIGINT N2,BIGINT N3,int ns)
+template<int ns, int W>
+static SIMD_INLINE void interp_cube(FLT *target,FLT *du, FLT *ker1, FLT *ker2, FLT *ker3,
+		 BIGINT i1,BIGINT i2,BIGINT i3, BIGINT N1,BIGINT N2,BIGINT N3)
 // 3D interpolate complex values from du (uniform grid data) array to out value,
 // using ns*ns*ns cube of real weights
 // in ker. out must be size 2 (real,imag), and du
@@ -809,24 +1958,13 @@ void interp_cube(FLT *target,FLT *du, FLT *ker1, FLT *ker2, FLT *ker3,
 // Periodic wrapping in the du array is applied, assuming N1,N2,N3>=ns.
 // dx,dy,dz indices into ker array, j index in complex du array.
 // Barnett 6/16/17
+// No-wrap case: explicit SIMD as in interp_square.
 {
   FLT out[] = {0.0, 0.0};  
-  if (i1>=0 && i1+ns<=N1 && i2>=0 && i2+ns<=N2 && i3>=0 && i3+ns<=N3) {
+  if (i1>=0 && i1+ns<=N1 && i2>=0 && i2+ns<=N2 && i3>=0 && i3+ns<=N3)
     // no wrapping: avoid ptrs
-    for (int dz=0; dz<ns; dz++) {
-      BIGINT oz = N1*N2*(i3+dz);        // offset due to z
-      for (int dy=0; dy<ns; dy++) {
-	BIGINT j = oz + N1*(i2+dy) + i1;
-	FLT ker23 = ker2[dy]*ker3[dz];
-	for (int dx=0; dx<ns; dx++) {
-	  FLT k = ker1[dx]*ker23;
-	  out[0] += du[2*j] * k;
-	  out[1] += du[2*j+1] * k;
-	  ++j;
-	}
-      }
-    }
-  } else {                         // wraps somewhere: use ptr list (slower)
+    interp_cube_nowrap<ns,W>(out,du+2*(N1*N2*i3+N1*i2+i1),ker1,ker2,ker3,N1,N1*N2);
+  else {                           // wraps somewhere: use ptr list (slower)
     BIGINT j1[MAX_NSPREAD], j2[MAX_NSPREAD], j3[MAX_NSPREAD];   // 1d ptr lists
     BIGINT x=i1, y=i2, z=i3;         // initialize coords
     for (int d=0; d<ns; d++) {          // set up ptr lists
@@ -858,8 +1996,347 @@ void interp_cube(FLT *target,FLT *du, FLT *ker1, FLT *ker2, FLT *ker3,
   target[1] = out[1];  
 }
 
-void spread_subproblem_1d(BIGINT off1, BIGINT size1,FLT *du,BIGINT M,
-			  FLT *kx,FLT *dd, const spread_opts& opts)
+template<int ns, int ndims, bool ghost>
+static SIMD_INLINE void prefetch_stencil(int ibuf, FLT *xjlist, FLT *yjlist,
+                     FLT *zjlist, BIGINT *i0, FLT *du, const BIGINT *P,
+                     BIGINT off, BIGINT N1, BIGINT N2, BIGINT N3)
+/* Prefetches the ns^ndims stencil of grid du (array sizes P, pt (0,0,0) at
+   index off) for the ibuf'th target of a chunk, as in interp_chunk_nd: its
+   corner is from cached indices i0 if not NULL, else from the folded coords.
+   Stencils that wrap (possible only without ghosts) are skipped.
+*/
+{
+  FLT ns2 = (FLT)ns/2;
+  BIGINT i1, i2=0, i3=0;
+  if (i0) {
+    i1 = i0[ndims*ibuf];
+    if (ndims > 1) i2 = i0[ndims*ibuf+1];
+    if (ndims > 2) i3 = i0[ndims*ibuf+2];
+  } else {
+    i1 = (BIGINT)std::ceil(xjlist[ibuf]-ns2);
+    if (ndims > 1) i2 = (BIGINT)std::ceil(yjlist[ibuf]-ns2);
+    if (ndims > 2) i3 = (BIGINT)std::ceil(zjlist[ibuf]-ns2);
+  }
+  if (!ghost && (i1<0 || i1+ns>N1 || (ndims>1 && (i2<0 || i2+ns>N2)) ||
+                 (ndims>2 && (i3<0 || i3+ns>N3))))
+    return;
+  FLT *c = du + 2*(off + i1 + P[0]*(i2 + P[1]*i3));    // stencil corner
+  for (int dz=0; dz<(ndims>2 ? ns : 1); dz++)
+    for (int dy=0; dy<(ndims>1 ? ns : 1); dy++)          // each row (x-line)
+      simd_prefetch_range(c + 2*(P[0]*(dy + P[1]*dz)), 2*ns*sizeof(FLT));
+}
+
+template<int ns, int ndims, int W, bool ghost>
+static SIMD_INLINE void interp_chunk_nd(FLT *outbuf, int n, FLT *xjlist, FLT *yjlist,
+                     FLT *zjlist, FLT *du, BIGINT N1, BIGINT N2, BIGINT N3,
+                     int nvec, BIGINT *i0, FLT *kv, const spread_opts *popts)
+/* Interpolate from the uniform grid du to a chunk of n NU targets, with folded
+   coords xjlist (and yjlist if ndims>1, zjlist if ndims>2), writing the n
+   complex outputs to outbuf. Helper for interpSorted.
+   If kv is not NULL, the coords are ignored, and the targets' grid start
+   indices and kernel values are read from i0 and kv (a KER_CACHE chunk).
+   With nvec grids (each N1*N2*N3, one after another in du) the kernel values
+   of each target are evaluated once and used for all of them; outbuf then
+   holds nvec complex outputs per target (target-major). Since ns and ndims are
+   template params, the dimension switch and kernel width ladder are done at
+   compile time, and the compiler knows all loop lengths. W is the SIMD vector
+   length (in FLTs) for the instruction set of the caller.
+   If ghost, du carries opts.ghost filled ghost pts per side (see wrap_ghosts),
+   so each stencil is read with no wrapping checks, from contiguous rows.
+   If opts.prefetch>0, the stencil rows of the target that many ahead are
+   prefetched (first grid only) while each target is done, hiding some of the
+   latency of the gathers (see prefetch_stencil).
+*/
+{
+  const spread_opts &opts = *popts;
+  FLT ns2 = (FLT)ns/2;          // half spread width, used as stencil shift
+  BIGINT P[3];                  // grid array sizes, incl any ghosts
+  BIGINT off = ghost_dims(P,N1,N2,N3,ghost ? opts.ghost : 0);  // of pt (0,0,0)
+  // Kernels: static alloc is faster, so we do it for up to 3D...
+  FLT kernel_args[3*MAX_NSPREAD];
+  FLT kernel_values[3*MAX_NSPREAD];
+  FLT *ker1 = kernel_values;
+  FLT *ker2 = kernel_values + ns;
+  FLT *ker3 = kernel_values + 2*ns;       
+  int pf = opts.prefetch;       // prefetch distance in targets
+  for (int ibuf=0; ibuf<min(pf,n); ibuf++)      // pipeline start
+    prefetch_stencil<ns,ndims,ghost>(ibuf,xjlist,yjlist,zjlist,kv ? i0 : NULL,du,P,off,N1,N2,N3);
+
+  // Loop over targets in chunk
+  for (int ibuf=0; ibuf<n; ibuf++) {
+    FLT *target = outbuf+2*nvec*ibuf;
+    if (pf && ibuf+pf<n)
+      prefetch_stencil<ns,ndims,ghost>(ibuf+pf,xjlist,yjlist,zjlist,kv ? i0 : NULL,du,P,off,N1,N2,N3);
+    BIGINT i1, i2=0, i3=0;
+    if (kv) {                            // cached start indices and kernels
+      i1 = i0[ndims*ibuf];
+      if (ndims > 1) i2 = i0[ndims*ibuf+1];
+      if (ndims > 2) i3 = i0[ndims*ibuf+2];
+      ker1 = kv + ndims*ns*ibuf;
+      ker2 = ker1 + ns;
+      ker3 = ker1 + 2*ns;
+    } else {
+      FLT xj = xjlist[ibuf];
+      FLT yj = (ndims > 1) ? yjlist[ibuf] : 0;
+      FLT zj = (ndims > 2) ? zjlist[ibuf] : 0;
+
+      // coords (x,y,z), spread block corner index (i1,i2,i3) of current NU targ
+      i1=(BIGINT)std::ceil(xj-ns2); // leftmost grid index
+      i2= (ndims > 1) ? (BIGINT)std::ceil(yj-ns2) : 0; // min y grid index
+      i3= (ndims > 2) ? (BIGINT)std::ceil(zj-ns2) : 0; // min z grid index
+
+      FLT x1=(FLT)i1-xj;           // shift of ker center, in [-w/2,-w/2+1]
+      FLT x2= (ndims > 1) ? (FLT)i2-yj : 0 ;
+      FLT x3= (ndims > 2)? (FLT)i3-zj : 0;
+
+      // eval kernel values patch and use to interpolate from uniform data...
+      if (opts.kerevalmeth==0) {               // choose eval method
+        set_kernel_args<ns>(kernel_args, x1);
+        if(ndims > 1)  set_kernel_args<ns>(kernel_args+ns, x2);
+        if(ndims > 2)  set_kernel_args<ns>(kernel_args+2*ns, x3);
+
+        evaluate_kernel_vector(kernel_values, kernel_args, opts, ndims*ns);
+      }
+
+      else{
+        eval_kernel_vec_Horner<ns>(ker1,x1,opts);
+        if (ndims > 1) eval_kernel_vec_Horner<ns>(ker2,x2,opts);  
+        if (ndims > 2) eval_kernel_vec_Horner<ns>(ker3,x3,opts);
+    }
+    }
+
+    BIGINT N = P[0]*P[1]*P[2];
+    for (int v=0; v<nvec; v++) {   // kernel vals are shared by all grids
+      FLT *duv = du + 2*N*v;
+      if (ghost) {                 // stencil lies in the padded grid
+        duv += 2*(off + i1 + P[0]*(i2 + P[1]*i3));   // its lowest corner
+        if (ndims==1)
+          interp_line_nowrap<ns>(target+2*v,duv,ker1);
+        else if (ndims==2)
+          interp_square_nowrap<ns,W>(target+2*v,duv,ker1,ker2,P[0]);
+        else
+          interp_cube_nowrap<ns,W>(target+2*v,duv,ker1,ker2,ker3,P[0],P[0]*P[1]);
+        continue;
+      }
+      switch(ndims){
+      case 1:
+        interp_line<ns>(target+2*v,duv,ker1,i1,N1);
+        break;
+      case 2:
+        interp_square<ns,W>(target+2*v,duv,ker1,ker2,i1,i2,N1,N2);
+        break;
+      case 3:
+        interp_cube<ns,W>(target+2*v,duv,ker1,ker2,ker3,i1,i2,i3,N1,N2,N3);
+        break;
+      default: //can't get here
+        break;
+      }
+    }
+  } // end loop over targets in chunk
+}
+
+template<int ns>
+static SIMD_INLINE void spread_line_nowrap(FLT *du, FLT *src, FLT *ker)
+// 1D spread as in spread_line, but to the ns complex values starting at du,
+// with no wrapping (the stencil lies in the array, eg it has ghosts).
+{
+  for (int dx=0; dx<ns; ++dx) {
+    du[2*dx] += src[0]*ker[dx];
+    du[2*dx+1] += src[1]*ker[dx];
+  }
+}
+
+template<int ns, int W>
+static SIMD_INLINE void spread_square_nowrap(FLT *du, FLT *src, FLT *ker1,
+                                             FLT *ker2, BIGINT P1)
+// 2D spread as in spread_square, with no wrapping, to the ns*ns square whose
+// lowest corner is at du, in a grid with row length P1: an explicit SIMD axpy
+// (W FLTs per vector) per row. Adjoint of interp_square_nowrap.
+{
+  FLT ker1val[2*MAX_NSPREAD];         // ker1 times the complex strength
+  for (int dx=0; dx<ns; dx++) {
+    ker1val[2*dx] = src[0]*ker1[dx];
+    ker1val[2*dx+1] = src[1]*ker1[dx];
+  }
+  for (int dy=0; dy<ns; dy++)
+    simd_ops<FLT,2*ns,W>::axpy(du+2*P1*dy, ker2[dy], ker1val);
+}
+
+template<int ns, int W>
+static SIMD_INLINE void spread_cube_nowrap(FLT *du, FLT *src, FLT *ker1,
+                                           FLT *ker2, FLT *ker3, BIGINT P1,
+                                           BIGINT P12)
+// 3D version of spread_square_nowrap; P12 is the grid plane size.
+{
+  FLT ker1val[2*MAX_NSPREAD];         // ker1 times the complex strength
+  for (int dx=0; dx<ns; dx++) {
+    ker1val[2*dx] = src[0]*ker1[dx];
+    ker1val[2*dx+1] = src[1]*ker1[dx];
+  }
+  for (int dz=0; dz<ns; dz++)
+    for (int dy=0; dy<ns; dy++)
+      simd_ops<FLT,2*ns,W>::axpy(du+2*(P12*dz+P1*dy), ker2[dy]*ker3[dz], ker1val);
+}
+
+template<int ns>
+static SIMD_INLINE void spread_line(FLT *du, FLT *src, FLT *ker, BIGINT i1, BIGINT N1)
+// 1D spread one complex strength src[0..1] with real weights ker[0..ns-1]
+// into the du array (size 2*N1, interleaved) from left-most index i1, with
+// periodic wrapping, assuming N1>=ns. The adjoint of interp_line.
+{
+  BIGINT j = i1;
+  if (i1<0 || i1+ns>N1) {                   // wraps somewhere
+    if (j<0) j+=N1;
+    for (int dx=0; dx<ns; ++dx) {
+      if (j>=N1) j-=N1;
+      du[2*j] += src[0]*ker[dx];
+      du[2*j+1] += src[1]*ker[dx];
+      ++j;
+    }
+  } else                                    // doesn't wrap
+    for (int dx=0; dx<ns; ++dx) {
+      du[2*j] += src[0]*ker[dx];
+      du[2*j+1] += src[1]*ker[dx];
+      ++j;
+    }
+}
+
+template<int ns, int W>
+static SIMD_INLINE void spread_square(FLT *du, FLT *src, FLT *ker1, FLT *ker2,
+                                      BIGINT i1, BIGINT i2, BIGINT N1, BIGINT N2)
+// 2D spread one complex strength src[0..1] with the ns*ns tensor product of
+// real weights ker1, ker2 into du (size 2*N1*N2, interleaved), whose lowest
+// corner is (i1,i2), with periodic wrapping, assuming N1,N2>=ns. Rows (y) are
+// wrapped via an index list; a row not wrapping in x is an explicit SIMD axpy
+// (W FLTs per vector), as in spread_subproblem_2d. Adjoint of interp_square.
+{
+  FLT ker1val[2*MAX_NSPREAD];         // ker1 times the complex strength
+  for (int dx=0; dx<ns; dx++) {
+    ker1val[2*dx] = src[0]*ker1[dx];
+    ker1val[2*dx+1] = src[1]*ker1[dx];
+  }
+  BIGINT j1[MAX_NSPREAD];
+  bool xwrap = (i1<0 || i1+ns>N1);
+  BIGINT x = (i1<0) ? i1+N1 : i1;     // (j1 only read if xwrap)
+  for (int dx=0; dx<ns; dx++, x++) {
+    if (x>=N1) x-=N1;
+    j1[dx] = x;
+  }
+  BIGINT y = (i2<0) ? i2+N2 : i2;
+  for (int dy=0; dy<ns; dy++, y++) {
+    if (y>=N2) y-=N2;
+    FLT *row = du + 2*N1*y;
+    if (!xwrap)
+      simd_ops<FLT,2*ns,W>::axpy(row+2*i1, ker2[dy], ker1val);
+    else
+      for (int dx=0; dx<ns; dx++) {
+        row[2*j1[dx]] += ker2[dy]*ker1val[2*dx];
+        row[2*j1[dx]+1] += ker2[dy]*ker1val[2*dx+1];
+      }
+  }
+}
+
+template<int ns, int W>
+static SIMD_INLINE void spread_cube(FLT *du, FLT *src, FLT *ker1, FLT *ker2, FLT *ker3,
+                                    BIGINT i1, BIGINT i2, BIGINT i3,
+                                    BIGINT N1, BIGINT N2, BIGINT N3)
+// 3D version of spread_square: spreads src with the ns^3 tensor product of
+// ker1, ker2, ker3 into du (size 2*N1*N2*N3) from lowest corner (i1,i2,i3),
+// with periodic wrapping, assuming N1,N2,N3>=ns. Adjoint of interp_cube.
+{
+  FLT ker1val[2*MAX_NSPREAD];         // ker1 times the complex strength
+  for (int dx=0; dx<ns; dx++) {
+    ker1val[2*dx] = src[0]*ker1[dx];
+    ker1val[2*dx+1] = src[1]*ker1[dx];
+  }
+  BIGINT j1[MAX_NSPREAD], j2[MAX_NSPREAD];
+  bool xwrap = (i1<0 || i1+ns>N1);
+  BIGINT x = (i1<0) ? i1+N1 : i1;     // (j1 only read if xwrap)
+  for (int dx=0; dx<ns; dx++, x++) {
+    if (x>=N1) x-=N1;
+    j1[dx] = x;
+  }
+  BIGINT y = (i2<0) ? i2+N2 : i2;
+  for (int dy=0; dy<ns; dy++, y++) {
+    if (y>=N2) y-=N2;
+    j2[dy] = y;
+  }
+  BIGINT z = (i3<0) ? i3+N3 : i3;
+  for (int dz=0; dz<ns; dz++, z++) {
+    if (z>=N3) z-=N3;
+    FLT *plane = du + 2*N1*N2*z;
+    for (int dy=0; dy<ns; dy++) {
+      FLT *row = plane + 2*N1*j2[dy];
+      FLT kerval = ker2[dy]*ker3[dz];
+      if (!xwrap)
+        simd_ops<FLT,2*ns,W>::axpy(row+2*i1, kerval, ker1val);
+      else
+        for (int dx=0; dx<ns; dx++) {
+          row[2*j1[dx]] += kerval*ker1val[2*dx];
+          row[2*j1[dx]+1] += kerval*ker1val[2*dx+1];
+        }
+    }
+  }
+}
+
+template<int ns, int ndims, int W, bool ghost>
+static SIMD_INLINE void spread_chunk_nd(FLT *du, int n, FLT *xjlist, FLT *yjlist,
+                     FLT *zjlist, FLT *inbuf, BIGINT N1, BIGINT N2, BIGINT N3,
+                     int nvec, BIGINT *i0, FLT *kv, const spread_opts *popts)
+/* Spread a chunk of n NU sources, with folded coords xjlist (and yjlist if
+   ndims>1, zjlist if ndims>2) and complex strengths inbuf, directly onto the
+   uniform grid du, with periodic wrapping (no subgrid). Helper for the direct
+   spreader in spreadSorted; the adjoint of interp_chunk_nd, with the same
+   conventions: nvec strengths per source in inbuf (source-major) go to as many
+   grids (each N1*N2*N3, one after another in du), sharing the kernel values;
+   if kv is not NULL, cached start indices i0 and kernel values kv are used.
+   If ghost, du carries popts->ghost ghost pts per side, which are spread to
+   without wrapping (to be folded in later by wrap_ghosts).
+*/
+{
+  FLT kernel_values[3*MAX_NSPREAD];
+  FLT *ker = kernel_values;
+  BIGINT i[3] = {0,0,0};
+  BIGINT P[3];                  // grid array sizes, incl any ghosts
+  BIGINT off = ghost_dims(P,N1,N2,N3,ghost ? popts->ghost : 0);  // of (0,0,0)
+  BIGINT N = P[0]*P[1]*P[2];
+  for (int ibuf=0; ibuf<n; ibuf++) {
+    if (kv) {                            // cached start indices and kernels
+      for (int d=0; d<ndims; d++)
+        i[d] = i0[ndims*ibuf+d];
+      ker = kv + ndims*ns*ibuf;
+    } else {
+      FLT x[3];
+      x[0] = xjlist[ibuf];
+      if (ndims>1) x[1] = yjlist[ibuf];
+      if (ndims>2) x[2] = zjlist[ibuf];
+      ker_point<ns>(i, kernel_values, ndims, x, popts);
+    }
+    for (int v=0; v<nvec; v++) {   // kernel vals are shared by all grids
+      FLT *duv = du + 2*N*v;
+      FLT *src = inbuf + 2*(nvec*ibuf+v);
+      if (ghost) {                 // stencil lies in the padded grid
+        duv += 2*(off + i[0] + P[0]*(i[1] + P[1]*i[2]));   // its lowest corner
+        if (ndims==1)
+          spread_line_nowrap<ns>(duv,src,ker);
+        else if (ndims==2)
+          spread_square_nowrap<ns,W>(duv,src,ker,ker+ns,P[0]);
+        else
+          spread_cube_nowrap<ns,W>(duv,src,ker,ker+ns,ker+2*ns,P[0],P[0]*P[1]);
+      } else if (ndims==1)
+        spread_line<ns>(duv,src,ker,i[0],N1);
+      else if (ndims==2)
+        spread_square<ns,W>(duv,src,ker,ker+ns,i[0],i[1],N1,N2);
+      else
+        spread_cube<ns,W>(duv,src,ker,ker+ns,ker+2*ns,i[0],i[1],i[2],N1,N2,N3);
+    }
+  }
+}
+
+template<int ns>
+static SIMD_INLINE void spread_subproblem_1d(BIGINT off1, BIGINT size1,FLT *du,BIGINT M,
+			  FLT *kx,FLT *dd, int nvec, BIGINT *i0, FLT *kv,
+                          const spread_opts& opts)
 /* 1D spreader from nonuniform to uniform subproblem grid, without wrapping.
    Inputs:
    off1 - integer offset of left end of du subgrid from that of overall fine
@@ -869,8 +2346,13 @@ void spread_subproblem_1d(BIGINT off1, BIGINT size1,FLT *du,BIGINT M,
    kx (length M) - are rescaled NU source locations, should lie in
                    [off1+ns/2,off1+size1-1-ns/2] so as kernels stay in bounds
    dd (length M complex, interleaved) - source strengths
+   nvec - number of strength vectors: dd holds nvec of them, one after another
+          (so dd has length nvec*M complex), all at the same NU pts
+   i0, kv - if kv is not NULL, the M pts' precomputed grid start indices and
+          ns kernel values (from a KER_CACHE); kx is then not read
    Outputs:
    du (length size1 complex, interleaved) - preallocated uniform subgrid array
+          (nvec such subgrids one after another, one per strength vector)
 
    The reason periodic wrapping is avoided in subproblems is speed: avoids
    conditionals, indirection (pointers), and integer mod. Originally 2017.
@@ -880,52 +2362,64 @@ void spread_subproblem_1d(BIGINT off1, BIGINT size1,FLT *du,BIGINT M,
    This needed off1 as extra arg. AHB 11/30/20.
 */
 {
-  int ns=opts.nspread;          // a.k.a. w
   FLT ns2 = (FLT)ns/2;          // half spread width
-  for (BIGINT i=0;i<2*size1;++i)         // zero output
+  for (BIGINT i=0;i<2*size1*nvec;++i)    // zero output
     du[i] = 0.0;
   FLT kernel_args[MAX_NSPREAD];
-  FLT ker[MAX_NSPREAD];
+  FLT kernel_values[MAX_NSPREAD];
+  FLT *ker = kernel_values;
   for (BIGINT i=0; i<M; i++) {           // loop over NU pts
-    FLT re0 = dd[2*i];
-    FLT im0 = dd[2*i+1];
-    // ceil offset, hence rounding, must match that in get_subgrid...
-    BIGINT i1 = (BIGINT)std::ceil(kx[i] - ns2);    // fine grid start index
-    FLT x1 = (FLT)i1 - kx[i];            // x1 in [-w/2,-w/2+1], up to rounding
-    // However if N1*epsmach>O(1) then can cause O(1) errors in x1, hence ppoly
-    // kernel evaluation will fall outside their designed domains, >>1 errors.
-    // This can only happen if the overall error would be O(1) anyway. Clip x1??
-    if (x1<-ns2) x1=-ns2;
-    if (x1>-ns2+1) x1=-ns2+1;   // ***
-    if (opts.kerevalmeth==0) {          // faster Horner poly method
-      set_kernel_args(kernel_args, x1, opts);
-      evaluate_kernel_vector(ker, kernel_args, opts, ns);
-    } else
-      eval_kernel_vec_Horner(ker,x1,ns,opts);
-    BIGINT j = i1-off1;    // offset rel to subgrid, starts the output indices
-    // critical inner loop:
-    for (int dx=0; dx<ns; ++dx) {
-      FLT k = ker[dx];
-      du[2*j] += re0*k;
-      du[2*j+1] += im0*k;
-      ++j;
+    BIGINT i1;
+    if (kv) {                            // cached start index and kernel
+      i1 = i0[i];
+      ker = kv + ns*i;
+    } else {
+      // ceil offset, hence rounding, must match that in get_subgrid...
+      i1 = (BIGINT)std::ceil(kx[i] - ns2);    // fine grid start index
+      FLT x1 = (FLT)i1 - kx[i];            // x1 in [-w/2,-w/2+1], up to rounding
+      // However if N1*epsmach>O(1) then can cause O(1) errors in x1, hence ppoly
+      // kernel evaluation will fall outside their designed domains, >>1 errors.
+      // This can only happen if the overall error would be O(1) anyway. Clip x1??
+      if (x1<-ns2) x1=-ns2;
+      if (x1>-ns2+1) x1=-ns2+1;   // ***
+      if (opts.kerevalmeth==0) {          // faster Horner poly method
+        set_kernel_args<ns>(kernel_args, x1);
+        evaluate_kernel_vector(ker, kernel_args, opts, ns);
+      } else
+        eval_kernel_vec_Horner<ns>(ker,x1,opts);
+    }
+    for (int v=0; v<nvec; ++v) {  // kernel vals are shared by all vectors
+      FLT re0 = dd[2*(M*v+i)];
+      FLT im0 = dd[2*(M*v+i)+1];
+      FLT *duv = du + 2*size1*v;
+      BIGINT j = i1-off1;    // offset rel to subgrid, starts the output indices
+      // critical inner loop:
+      for (int dx=0; dx<ns; ++dx) {
+        FLT k = ker[dx];
+        duv[2*j] += re0*k;
+        duv[2*j+1] += im0*k;
+        ++j;
+      }
     }
   }
 }
 
-void spread_subproblem_2d(BIGINT off1,BIGINT off2,BIGINT size1,BIGINT size2,
+template<int ns, int W>
+static SIMD_INLINE void spread_subproblem_2d(BIGINT off1,BIGINT off2,BIGINT size1,BIGINT size2,
                           FLT *du,BIGINT M, FLT *kx,FLT *ky,FLT *dd,
-			  const spread_opts& opts)
+			  int nvec, BIGINT *i0, FLT *kv, const spread_opts& opts)
 /* spreader from dd (NU) to du (uniform) in 2D without wrapping.
    See above docs/notes for spread_subproblem_2d.
    kx,ky (size M) are NU locations in [off+ns/2,off+size-1-ns/2] in both dims.
    dd (size M complex) are complex source strengths
    du (size size1*size2) is complex uniform output array
+   (nvec>1: as many dd vectors and du subgrids, each one after the other)
+   (kv not NULL: cached start indices i0 and kernel values kv used, not kx,ky)
  */
 {
-  int ns=opts.nspread;
   FLT ns2 = (FLT)ns/2;          // half spread width
-  for (BIGINT i=0;i<2*size1*size2;++i)
+  BIGINT gs = 2*size1*size2;    // # FLTs per subgrid
+  for (BIGINT i=0;i<gs*nvec;++i)
     du[i] = 0.0;
   FLT kernel_args[2*MAX_NSPREAD];
   // Kernel values stored in consecutive memory. This allows us to compute
@@ -934,53 +2428,64 @@ void spread_subproblem_2d(BIGINT off1,BIGINT off2,BIGINT size1,BIGINT size2,
   FLT *ker1 = kernel_values;
   FLT *ker2 = kernel_values + ns;  
   for (BIGINT i=0; i<M; i++) {           // loop over NU pts
-    FLT re0 = dd[2*i];
-    FLT im0 = dd[2*i+1];
-    // ceil offset, hence rounding, must match that in get_subgrid...
-    BIGINT i1 = (BIGINT)std::ceil(kx[i] - ns2);   // fine grid start indices
-    BIGINT i2 = (BIGINT)std::ceil(ky[i] - ns2);
-    FLT x1 = (FLT)i1 - kx[i];
-    FLT x2 = (FLT)i2 - ky[i];
-    if (opts.kerevalmeth==0) {          // faster Horner poly method
-      set_kernel_args(kernel_args, x1, opts);
-      set_kernel_args(kernel_args+ns, x2, opts);
-      evaluate_kernel_vector(kernel_values, kernel_args, opts, 2*ns);
+    BIGINT i1, i2;
+    if (kv) {                            // cached start indices and kernels
+      i1 = i0[2*i];
+      i2 = i0[2*i+1];
+      ker1 = kv + 2*ns*i;
+      ker2 = ker1 + ns;
     } else {
-      eval_kernel_vec_Horner(ker1,x1,ns,opts);
-      eval_kernel_vec_Horner(ker2,x2,ns,opts);
-    }
-    // Combine kernel with complex source value to simplify inner loop
-    FLT ker1val[2*MAX_NSPREAD];    // here 2* is because of complex
-    for (int i = 0; i < ns; i++) {
-      ker1val[2*i] = re0*ker1[i];
-      ker1val[2*i+1] = im0*ker1[i];
-    }    
-    // critical inner loop:
-    for (int dy=0; dy<ns; ++dy) {
-      BIGINT j = size1*(i2-off2+dy) + i1-off1;   // should be in subgrid
-      FLT kerval = ker2[dy];
-      FLT *trg = du+2*j;
-      for (int dx=0; dx<2*ns; ++dx) {
-	trg[dx] += kerval*ker1val[dx];
-      }	
+      // ceil offset, hence rounding, must match that in get_subgrid...
+      i1 = (BIGINT)std::ceil(kx[i] - ns2);   // fine grid start indices
+      i2 = (BIGINT)std::ceil(ky[i] - ns2);
+      FLT x1 = (FLT)i1 - kx[i];
+      FLT x2 = (FLT)i2 - ky[i];
+      if (opts.kerevalmeth==0) {          // faster Horner poly method
+        set_kernel_args<ns>(kernel_args, x1);
+        set_kernel_args<ns>(kernel_args+ns, x2);
+        evaluate_kernel_vector(kernel_values, kernel_args, opts, 2*ns);
+      } else {
+        eval_kernel_vec_Horner<ns>(ker1,x1,opts);
+        eval_kernel_vec_Horner<ns>(ker2,x2,opts);
+      }
+    }
+    for (int v=0; v<nvec; ++v) {  // kernel vals are shared by all vectors
+      FLT re0 = dd[2*(M*v+i)];
+      FLT im0 = dd[2*(M*v+i)+1];
+      // Combine kernel with complex source value to simplify inner loop
+      FLT ker1val[2*MAX_NSPREAD];    // here 2* is because of complex
+      for (int i = 0; i < ns; i++) {
+        ker1val[2*i] = re0*ker1[i];
+        ker1val[2*i+1] = im0*ker1[i];
+      }    
+      // critical inner loop (explicit SIMD, W FLTs per vector):
+      for (int dy=0; dy<ns; ++dy) {
+        BIGINT j = size1*(i2-off2+dy) + i1-off1;   // should be in subgrid
+        FLT kerval = ker2[dy];
+        FLT *trg = du+gs*v+2*j;
+        simd_ops<FLT,2*ns,W>::axpy(trg, kerval, ker1val);
+      }
     }
   }
 }
 
-void spread_subproblem_3d(BIGINT off1,BIGINT off2,BIGINT off3,BIGINT size1,
+template<int ns, int W>
+static SIMD_INLINE void spread_subproblem_3d(BIGINT off1,BIGINT off2,BIGINT off3,BIGINT size1,
                           BIGINT size2,BIGINT size3,FLT *du,BIGINT M,
 			  FLT *kx,FLT *ky,FLT *kz,FLT *dd,
-			  const spread_opts& opts)
+			  int nvec, BIGINT *i0, FLT *kv, const spread_opts& opts)
 /* spreader from dd (NU) to du (uniform) in 3D without wrapping.
    See above docs/notes for spread_subproblem_2d.
    kx,ky,kz (size M) are NU locations in [off+ns/2,off+size-1-ns/2] in each dim.
    dd (size M complex) are complex source strengths
    du (size size1*size2*size3) is uniform complex output array
+   (nvec>1: as many dd vectors and du subgrids, each one after the other)
+   (kv not NULL: cached start indices i0 and kernel values kv used, not kx..)
  */
 {
-  int ns=opts.nspread;
   FLT ns2 = (FLT)ns/2;          // half spread width
-  for (BIGINT i=0;i<2*size1*size2*size3;++i)
+  BIGINT gs = 2*size1*size2*size3;   // # FLTs per subgrid
+  for (BIGINT i=0;i<gs*nvec;++i)
     du[i] = 0.0;
   FLT kernel_args[3*MAX_NSPREAD];
   // Kernel values stored in consecutive memory. This allows us to compute
@@ -990,46 +2495,107 @@ void spread_subproblem_3d(BIGINT off1,BIGINT off2,BIGINT off3,BIGINT size1,
   FLT *ker2 = kernel_values + ns;
   FLT *ker3 = kernel_values + 2*ns;  
   for (BIGINT i=0; i<M; i++) {           // loop over NU pts
-    FLT re0 = dd[2*i];
-    FLT im0 = dd[2*i+1];
-    // ceil offset, hence rounding, must match that in get_subgrid...
-    BIGINT i1 = (BIGINT)std::ceil(kx[i] - ns2);   // fine grid start indices
-    BIGINT i2 = (BIGINT)std::ceil(ky[i] - ns2);
-    BIGINT i3 = (BIGINT)std::ceil(kz[i] - ns2);
-    FLT x1 = (FLT)i1 - kx[i];
-    FLT x2 = (FLT)i2 - ky[i];
-    FLT x3 = (FLT)i3 - kz[i];
-    if (opts.kerevalmeth==0) {          // faster Horner poly method
-      set_kernel_args(kernel_args, x1, opts);
-      set_kernel_args(kernel_args+ns, x2, opts);
-      set_kernel_args(kernel_args+2*ns, x3, opts);
-      evaluate_kernel_vector(kernel_values, kernel_args, opts, 3*ns);
+    BIGINT i1, i2, i3;
+    if (kv) {                            // cached start indices and kernels
+      i1 = i0[3*i];
+      i2 = i0[3*i+1];
+      i3 = i0[3*i+2];
+      ker1 = kv + 3*ns*i;
+      ker2 = ker1 + ns;
+      ker3 = ker1 + 2*ns;
     } else {
-      eval_kernel_vec_Horner(ker1,x1,ns,opts);
-      eval_kernel_vec_Horner(ker2,x2,ns,opts);
-      eval_kernel_vec_Horner(ker3,x3,ns,opts);
-    }
-    // Combine kernel with complex source value to simplify inner loop
-    FLT ker1val[2*MAX_NSPREAD];    // here 2* is because of complex
-    for (int i = 0; i < ns; i++) {
-      ker1val[2*i] = re0*ker1[i];
-      ker1val[2*i+1] = im0*ker1[i];	
-    }    
-    // critical inner loop:
-    for (int dz=0; dz<ns; ++dz) {
-      BIGINT oz = size1*size2*(i3-off3+dz);        // offset due to z
-      for (int dy=0; dy<ns; ++dy) {
-	BIGINT j = oz + size1*(i2-off2+dy) + i1-off1;   // should be in subgrid
-	FLT kerval = ker2[dy]*ker3[dz];
-	FLT *trg = du+2*j;
-	for (int dx=0; dx<2*ns; ++dx) {
-	  trg[dx] += kerval*ker1val[dx];
-	}	
+      // ceil offset, hence rounding, must match that in get_subgrid...
+      i1 = (BIGINT)std::ceil(kx[i] - ns2);   // fine grid start indices
+      i2 = (BIGINT)std::ceil(ky[i] - ns2);
+      i3 = (BIGINT)std::ceil(kz[i] - ns2);
+      FLT x1 = (FLT)i1 - kx[i];
+      FLT x2 = (FLT)i2 - ky[i];
+      FLT x3 = (FLT)i3 - kz[i];
+      if (opts.kerevalmeth==0) {          // faster Horner poly method
+        set_kernel_args<ns>(kernel_args, x1);
+        set_kernel_args<ns>(kernel_args+ns, x2);
+        set_kernel_args<ns>(kernel_args+2*ns, x3);
+        evaluate_kernel_vector(kernel_values, kernel_args, opts, 3*ns);
+      } else {
+        eval_kernel_vec_Horner<ns>(ker1,x1,opts);
+        eval_kernel_vec_Horner<ns>(ker2,x2,opts);
+        eval_kernel_vec_Horner<ns>(ker3,x3,opts);
+      }
+    }
+    for (int v=0; v<nvec; ++v) {  // kernel vals are shared by all vectors
+      FLT re0 = dd[2*(M*v+i)];
+      FLT im0 = dd[2*(M*v+i)+1];
+      // Combine kernel with complex source value to simplify inner loop
+      FLT ker1val[2*MAX_NSPREAD];    // here 2* is because of complex
+      for (int i = 0; i < ns; i++) {
+        ker1val[2*i] = re0*ker1[i];
+        ker1val[2*i+1] = im0*ker1[i];	
+      }    
+      // critical inner loop (explicit SIMD, W FLTs per vector):
+      for (int dz=0; dz<ns; ++dz) {
+        BIGINT oz = size1*size2*(i3-off3+dz);        // offset due to z
+        for (int dy=0; dy<ns; ++dy) {
+          BIGINT j = oz + size1*(i2-off2+dy) + i1-off1;   // should be in subgrid
+          FLT kerval = ker2[dy]*ker3[dz];
+          FLT *trg = du+gs*v+2*j;
+          simd_ops<FLT,2*ns,W>::axpy(trg, kerval, ker1val);
+        }
       }
     }
   }
 }
 
+template<int ns, int ndims, int W>
+static SIMD_INLINE void spread_subproblem_nd(BIGINT *offset, BIGINT *size, FLT *du, BIGINT M,
+                          FLT *kx, FLT *ky, FLT *kz, FLT *dd, int nvec,
+                          BIGINT *i0, FLT *kv, const spread_opts *opts)
+/* Calls the spread_subproblem_?d for dimension ndims, given subgrid offsets
+   offset[0..2] and sizes size[0..2] (as stored in a SPREAD_PLAN). This has a
+   uniform signature, so that one instance per ns, ndims and instruction set
+   can be selected once by set_spread_kernels. W is the SIMD vector length.
+   nvec strength vectors dd at the same NU pts are spread to as many subgrids.
+   i0, kv are the pts' cached start indices and kernel values, if kv non-NULL.
+*/
+{
+  if (ndims==1)
+    spread_subproblem_1d<ns>(offset[0],size[0],du,M,kx,dd,nvec,i0,kv,*opts);
+  else if (ndims==2)
+    spread_subproblem_2d<ns,W>(offset[0],offset[1],size[0],size[1],du,M,kx,ky,dd,nvec,i0,kv,*opts);
+  else
+    spread_subproblem_3d<ns,W>(offset[0],offset[1],offset[2],size[0],size[1],size[2],du,M,kx,ky,kz,dd,nvec,i0,kv,*opts);
+}
+
+template<int ns>
+static void ker_point(BIGINT *i0, FLT *ker, int ndims, FLT *x,
+                      const spread_opts *popts)
+/* For one folded NU pt with coords x[0..ndims-1], writes its fine grid start
+   index per dim to i0[0..ndims-1], and its ns kernel values per dim to
+   ker[0..ndims*ns-1], computed exactly as in the spreaders and interpolators
+   above (so their cached use gives the same answer). Helper for
+   setup_ker_cache; as a template on ns it can use the Horner evaluator.
+*/
+{
+  const spread_opts &opts = *popts;
+  FLT ns2 = (FLT)ns/2;          // half spread width
+  FLT kernel_args[3*MAX_NSPREAD];
+  FLT kernel_values[3*MAX_NSPREAD];
+  FLT xs[3];
+  for (int d=0; d<ndims; d++) {
+    // ceil offset, hence rounding, must match that in get_subgrid...
+    i0[d] = (BIGINT)std::ceil(x[d] - ns2);
+    xs[d] = (FLT)i0[d] - x[d];        // in [-w/2,-w/2+1], up to rounding
+  }
+  if (opts.kerevalmeth==0) {
+    for (int d=0; d<ndims; d++)
+      set_kernel_args<ns>(kernel_args+d*ns, xs[d]);
+    evaluate_kernel_vector(kernel_values, kernel_args, opts, ndims*ns);
+  } else
+    for (int d=0; d<ndims; d++)
+      eval_kernel_vec_Horner<ns>(kernel_values+d*ns,xs[d],opts);
+  for (int k=0; k<ndims*ns; k++)
+    ker[k] = kernel_values[k];
+}
+
 void add_wrapped_subgrid(BIGINT offset1,BIGINT offset2,BIGINT offset3,
 			 BIGINT size1,BIGINT size2,BIGINT size3,BIGINT N1,
 			 BIGINT N2,BIGINT N3,FLT *data_uniform, FLT *du0)
@@ -1041,25 +2607,20 @@ void add_wrapped_subgrid(BIGINT offset1,BIGINT offset2,BIGINT offset3,
    Barnett 3/27/18 made separate routine, tried to speed up inner loop.
 */
 {
-  std::vector<BIGINT> o2(size2), o3(size3);
-  BIGINT y=offset2, z=offset3;    // fill wrapped ptr lists in slower dims y,z...
-  for (int i=0; i<size2; ++i) {
-    if (y<0) y+=N2;
-    if (y>=N2) y-=N2;
-    o2[i] = y++;
-  }
-  for (int i=0; i<size3; ++i) {
-    if (z<0) z+=N3;
-    if (z>=N3) z-=N3;
-    o3[i] = z++;
-  }
   BIGINT nlo = (offset1<0) ? -offset1 : 0;          // # wrapping below in x
   BIGINT nhi = (offset1+size1>N1) ? offset1+size1-N1 : 0;    // " above in x
-  // this triple loop works in all dims
-  for (int dz=0; dz<size3; dz++) {       // use ptr lists in each axis
-    BIGINT oz = N1*N2*o3[dz];            // offset due to z (0 in <3D)
+  // this triple loop works in all dims; wrap slower dims y,z on the fly
+  // (no ptr lists, so no allocation)...
+  for (int dz=0; dz<size3; dz++) {
+    BIGINT z = offset3+dz;
+    if (z<0) z+=N3;
+    if (z>=N3) z-=N3;
+    BIGINT oz = N1*N2*z;                 // offset due to z (0 in <3D)
     for (int dy=0; dy<size2; dy++) {
-      BIGINT oy = oz + N1*o2[dy];        // off due to y & z (0 in 1D)
+      BIGINT y = offset2+dy;
+      if (y<0) y+=N2;
+      if (y>=N2) y-=N2;
+      BIGINT oy = oz + N1*y;             // off due to y & z (0 in 1D)
       FLT *out = data_uniform + 2*oy;
       FLT *in  = du0 + 2*size1*(dy + size2*dz);   // ptr to subgrid array
       BIGINT o = 2*(offset1+N1);         // 1d offset for output
@@ -1086,25 +2647,20 @@ void add_wrapped_subgrid_thread_safe(BIGINT offset1,BIGINT offset2,BIGINT offset
    using atomic writes (R Blackwell, Nov 2020).
 */
 {
-  std::vector<BIGINT> o2(size2), o3(size3);
-  BIGINT y=offset2, z=offset3;    // fill wrapped ptr lists in slower dims y,z...
-  for (int i=0; i<size2; ++i) {
-    if (y<0) y+=N2;
-    if (y>=N2) y-=N2;
-    o2[i] = y++;
-  }
-  for (int i=0; i<size3; ++i) {
-    if (z<0) z+=N3;
-    if (z>=N3) z-=N3;
-    o3[i] = z++;
-  }
   BIGINT nlo = (offset1<0) ? -offset1 : 0;          // # wrapping below in x
   BIGINT nhi = (offset1+size1>N1) ? offset1+size1-N1 : 0;    // " above in x
-  // this triple loop works in all dims
-  for (int dz=0; dz<size3; dz++) {       // use ptr lists in each axis
-    BIGINT oz = N1*N2*o3[dz];            // offset due to z (0 in <3D)
+  // this triple loop works in all dims; wrap slower dims y,z on the fly
+  // (no ptr lists, so no allocation)...
+  for (int dz=0; dz<size3; dz++) {
+    BIGINT z = offset3+dz;
+    if (z<0) z+=N3;
+    if (z>=N3) z-=N3;
+    BIGINT oz = N1*N2*z;                 // offset due to z (0 in <3D)
     for (int dy=0; dy<size2; dy++) {
-      BIGINT oy = oz + N1*o2[dy];        // off due to y & z (0 in 1D)
+      BIGINT y = offset2+dy;
+      if (y<0) y+=N2;
+      if (y>=N2) y-=N2;
+      BIGINT oy = oz + N1*y;             // off due to y & z (0 in 1D)
       FLT *out = data_uniform + 2*oy;
       FLT *in  = du0 + 2*size1*(dy + size2*dz);   // ptr to subgrid array
       BIGINT o = 2*(offset1+N1);         // 1d offset for output
@@ -1126,10 +2682,151 @@ void add_wrapped_subgrid_thread_safe(BIGINT offset1,BIGINT offset2,BIGINT offset
   }
 }
 
+static void add_subgrid_ghost(BIGINT *g, BIGINT *P, FLT *du, FLT *du0,
+                              bool atomic)
+/* Add a subgrid (du0), with offsets and sizes g[0..5] as in the spread plan,
+   to an output grid carrying ghost pts, with array sizes P[0..2] (see
+   ghost_dims), du pointing to its pt (0,0,0). Since the subgrid lies within
+   the ghosts, each x-row is added contiguously with no wrapping. Not
+   thread-safe unless atomic, when each add is an OMP atomic, as in
+   add_wrapped_subgrid_thread_safe.
+*/
+{
+  for (BIGINT dz=0; dz<g[5]; dz++)
+    for (BIGINT dy=0; dy<g[4]; dy++) {
+      FLT *out = du + 2*(g[0] + P[0]*(g[1]+dy + P[1]*(g[2]+dz)));
+      FLT *in = du0 + 2*g[3]*(dy + g[4]*dz);     // ptr to subgrid row
+      if (atomic)
+        for (BIGINT j=0; j<2*g[3]; j++) {
+#pragma omp atomic
+          out[j] += in[j];
+        }
+      else
+        for (BIGINT j=0; j<2*g[3]; j++)
+          out[j] += in[j];
+    }
+}
+
+static void copy_wrapped_subgrid(BIGINT *g, BIGINT N1, BIGINT N2, BIGINT N3,
+                                 BIGINT *P, FLT *du, FLT *du0)
+/* Copy into the subgrid du0 (offsets and sizes g[0..5] as in the spread plan,
+   each within one period of the grid) the pts it covers of the periodic grid
+   of sizes N1,N2,N3, stored in an array with sizes P[0..2] (see ghost_dims,
+   so any ghost pts are skipped) and du pointing to its pt (0,0,0). The
+   reverse of add_wrapped_subgrid: each x-row is copied as up to three
+   contiguous pieces (wrapped low end, middle, wrapped high end).
+*/
+{
+  BIGINT nlo = (g[0]<0) ? -g[0] : 0;              // # pts wrapped from the top
+  BIGINT nhi = (g[0]+g[3]>N1) ? g[0]+g[3]-N1 : 0; // # wrapped from the bottom
+  for (BIGINT dz=0; dz<g[5]; dz++) {
+    BIGINT z = g[2]+dz;
+    if (z<0) z+=N3;
+    if (z>=N3) z-=N3;
+    for (BIGINT dy=0; dy<g[4]; dy++) {
+      BIGINT y = g[1]+dy;
+      if (y<0) y+=N2;
+      if (y>=N2) y-=N2;
+      FLT *in = du + 2*P[0]*(y + P[1]*z);          // ptr to grid row
+      FLT *out = du0 + 2*g[3]*(dy + g[4]*dz);      // ptr to subgrid row
+      memcpy(out, in+2*(N1-nlo), sizeof(FLT)*2*nlo);
+      memcpy(out+2*nlo, in+2*(g[0]+nlo), sizeof(FLT)*2*(g[3]-nlo-nhi));
+      memcpy(out+2*(g[3]-nhi), in, sizeof(FLT)*2*nhi);
+    }
+  }
+}
+
+static unsigned long long curve_key(BIGINT *X, int n, int bits, int bin_order)
+/* Position along a space-filling curve of the point X (n coords, each in
+   [0,2^bits), X[0] the slowest-varying), for bin_order=1: Morton (Z-order),
+   ie the coords' bits interleaved; 2: Hilbert, via Skilling's transform of X
+   to the curve's "transposed" index (AIP Conf. Proc. 707, 381 (2004)), then
+   interleaved likewise. Needs n*bits<=64. X is overwritten.
+*/
+{
+  if (bin_order==2) {
+    BIGINT M = (BIGINT)1 << (bits-1);
+    for (BIGINT Q=M; Q>1; Q>>=1) {     // inverse undo excess work
+      BIGINT P = Q-1;
+      for (int i=0; i<n; ++i)
+        if (X[i] & Q)
+          X[0] ^= P;                   // invert
+        else {
+          BIGINT t = (X[0]^X[i]) & P;  // exchange
+          X[0] ^= t; X[i] ^= t;
+        }
+    }
+    for (int i=1; i<n; ++i)            // Gray encode
+      X[i] ^= X[i-1];
+    BIGINT t = 0;
+    for (BIGINT Q=M; Q>1; Q>>=1)
+      if (X[n-1] & Q) t ^= Q-1;
+    for (int i=0; i<n; ++i)
+      X[i] ^= t;
+  }
+  unsigned long long key = 0;
+  for (int q=bits-1; q>=0; --q)
+    for (int i=0; i<n; ++i)
+      key = (key<<1) | ((X[i]>>q) & 1);
+  return key;
+}
+
+template <class I>
+static void bin_offsets(std::vector<I> &offsets,
+                        const std::vector<I> &counts, BIGINT nbins1,
+                        BIGINT nbins2, BIGINT nbins3, int bin_order)
+/* Writes to offsets (length nbins1*nbins2*nbins3) the sorted index of the
+   first NU pt in each bin (of index i1+nbins1*(i2+nbins2*i3), holding counts
+   NU pts), given the order the bins are read out in. bin_order=0: Cartesian
+   (x fastest, z slowest), ie offsets = [0 cumsum(counts(1:end-1))]. 1 or 2:
+   along a Morton or Hilbert curve (see curve_key) through a power-of-two
+   square or cube, over the dims with more than one bin, each dim's bin
+   indices being stretched to fill its side. Thus the curve never leaves the
+   bins (to come back far away), but skips over gaps, and a run of bins is
+   compact in all dims (not a strip in x), with the aspect ratio of the whole
+   grid rather than of the bins. Only the nonempty bins are ordered (sorting
+   their keys), so this costs O(min(M,nbins) log) on top of the bin sort's
+   O(nbins+M); the offsets of empty bins are set to 0 (never read).
+*/
+{
+  BIGINT nbins = nbins1*nbins2*nbins3;
+  BIGINT nbd[3] = {nbins3,nbins2,nbins1};   // slowest dim first
+  int n = 0, bits = 1;                      // # curve dims, and bits per dim
+  for (int d=0; d<3; ++d)
+    if (nbd[d]>1) {
+      ++n;
+      while (((BIGINT)1<<bits) < nbd[d]) ++bits;
+    }
+  if (bin_order==0 || n<2 || n*bits>64) {   // Cartesian (same in 1D)
+    offsets[0]=0;
+    for (BIGINT i=1; i<nbins; i++)
+      offsets[i]=offsets[i-1]+counts[i-1];
+    return;
+  }
+  std::vector< std::pair<unsigned long long,BIGINT> > kb;  // (key,bin) pairs
+  for (BIGINT b=0; b<nbins; ++b)
+    if (counts[b]) {
+      BIGINT ib[3] = {b/(nbins1*nbins2), (b/nbins1)%nbins2, b%nbins1};
+      BIGINT X[3];
+      int i = 0;
+      for (int d=0; d<3; ++d)
+        if (nbd[d]>1) X[i++] = (ib[d]<<bits)/nbd[d];   // stretch to cube
+      kb.push_back(std::make_pair(curve_key(X,n,bits,bin_order),b));
+    }
+  std::sort(kb.begin(),kb.end());
+  std::fill(offsets.begin(),offsets.end(),0);
+  I o = 0;
+  for (size_t k=0; k<kb.size(); ++k) {
+    offsets[kb[k].second] = o;
+    o += counts[kb[k].second];
+  }
+}
 
-void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+template <class I>
+void bin_sort_singlethread(I *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,
-	      double bin_size_x,double bin_size_y,double bin_size_z, int debug)
+	      double bin_size_x,double bin_size_y,double bin_size_z,
+              int bin_order, int debug)
 /* Returns permutation of all nonuniform points with good RAM access,
  * ie less cache misses for spreading, in 1D, 2D, or 3D. Single-threaded version
  *
@@ -1138,6 +2835,8 @@ void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
  * these bins in a Cartesian cuboid ordering (x fastest, y med, z slowest).
  * Finally the permutation is inverted, so that the good ordering is: the
  * NU pt of index ret[0], the NU pt of index ret[1],..., NU pt of index ret[M-1]
+ * If bin_order>0 the bins are instead read out along a space-filling curve
+ * (see bin_offsets).
  * 
  * Inputs: M - number of input NU points.
  *         kx,ky,kz - length-M arrays of real coords of NU pts, in the domain
@@ -1147,9 +2846,12 @@ void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
  *         bin_size_x,y,z - what binning box size to use in each dimension
  *                    (in rescaled coords where ranges are [0,Ni] ).
  *                    For 1D, only bin_size_x is used; for 2D, it & bin_size_y.
+ *         bin_order - 0: Cartesian, 1: Morton, 2: Hilbert (see spread_opts.h)
  * Output:
  *         writes to ret a vector list of indices, each in the range 0,..,M-1.
- *         Thus, ret must have been preallocated for M BIGINTs.
+ *         Thus, ret must have been preallocated for M I's. The index type I
+ *         (BIGINT, or uint32_t if M fits) is also used for the bin counts,
+ *         offsets and the inverse map, so they take half the RAM if 32-bit.
  *
  * Notes: I compared RAM usage against declaring an internal vector and passing
  * back; the latter used more RAM and was slower.
@@ -1168,7 +2870,7 @@ void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
   nbins3 = iskz ? N3/bin_size_z+1 : 1;
   BIGINT nbins = nbins1*nbins2*nbins3;
 
-  std::vector<BIGINT> counts(nbins,0);  // count how many pts in each bin
+  std::vector<I> counts(nbins,0);  // count how many pts in each bin
   for (BIGINT i=0; i<M; i++) {
     // find the bin index in however many dims are needed
     BIGINT i1=FOLDRESCALE(kx[i],N1,pirange)/bin_size_x, i2=0, i3=0;
@@ -1177,19 +2879,17 @@ void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
     BIGINT bin = i1+nbins1*(i2+nbins2*i3);
     counts[bin]++;
   }
-  std::vector<BIGINT> offsets(nbins);   // cumulative sum of bin counts
-  offsets[0]=0;     // do: offsets = [0 cumsum(counts(1:end-1)]
-  for (BIGINT i=1; i<nbins; i++)
-    offsets[i]=offsets[i-1]+counts[i-1];
+  std::vector<I> offsets(nbins);   // cumulative sum of bin counts
+  bin_offsets(offsets,counts,nbins1,nbins2,nbins3,bin_order);
   
-  std::vector<BIGINT> inv(M);           // fill inverse map
+  std::vector<I> inv(M);           // fill inverse map
   for (BIGINT i=0; i<M; i++) {
     // find the bin index (again! but better than using RAM)
     BIGINT i1=FOLDRESCALE(kx[i],N1,pirange)/bin_size_x, i2=0, i3=0;
     if (isky) i2 = FOLDRESCALE(ky[i],N2,pirange)/bin_size_y;
     if (iskz) i3 = FOLDRESCALE(kz[i],N3,pirange)/bin_size_z;
     BIGINT bin = i1+nbins1*(i2+nbins2*i3);
-    BIGINT offset=offsets[bin];
+    I offset=offsets[bin];
     offsets[bin]++;
     inv[i]=offset;
   }
@@ -1198,10 +2898,11 @@ void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
     ret[inv[i]]=i;
 }
 
-void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+template <class I>
+void bin_sort_multithread(I *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,
-              double bin_size_x,double bin_size_y,double bin_size_z, int debug,
-              int nthr)
+              double bin_size_x,double bin_size_y,double bin_size_z,
+              int bin_order, int debug, int nthr)
 /* Mostly-OpenMP'ed version of bin_sort.
    For documentation see: bin_sort_singlethread.
    Caution: when M (# NU pts) << N (# U pts), is SLOWER than single-thread.
@@ -1224,11 +2925,11 @@ void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
   for (int t=0; t<=nt; ++t)
     brk[t] = (BIGINT)(0.5 + M*t/(double)nt);   // start index for t'th chunk
   
-  std::vector<BIGINT> counts(nbins,0);     // global counts: # pts in each bin
+  std::vector<I> counts(nbins,0);     // global counts: # pts in each bin
   // offsets per thread, size nt * nbins, init to 0 by copying the counts vec...
-  std::vector< std::vector<BIGINT> > ot(nt,counts);
+  std::vector< std::vector<I> > ot(nt,counts);
   {    // scope for ct, the 2d array of counts in bins for each thread's NU pts
-    std::vector< std::vector<BIGINT> > ct(nt,counts);   // nt * nbins, init to 0
+    std::vector< std::vector<I> > ct(nt,counts);   // nt * nbins, init to 0
     
 #pragma omp parallel num_threads(nt)
     {  // parallel binning to each thread's count. Block done once per thread
@@ -1248,11 +2949,8 @@ void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
       for (int t=0; t<nt; ++t)
 	counts[b] += ct[t][b];
     
-    std::vector<BIGINT> offsets(nbins);   // cumulative sum of bin counts
-    // do: offsets = [0 cumsum(counts(1:end-1))] ...
-    offsets[0] = 0;
-    for (BIGINT i=1; i<nbins; i++)
-      offsets[i]=offsets[i-1]+counts[i-1];
+    std::vector<I> offsets(nbins);   // cumulative sum of bin counts
+    bin_offsets(offsets,counts,nbins1,nbins2,nbins3,bin_order);
     
     for (BIGINT b=0; b<nbins; ++b)  // now build offsets for each thread & bin:
       ot[0][b] = offsets[b];                     // init
@@ -1262,7 +2960,7 @@ void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
     
   }  // scope frees up ct here, before inv alloc
   
-  std::vector<BIGINT> inv(M);           // fill inverse map, in parallel
+  std::vector<I> inv(M);           // fill inverse map, in parallel
 #pragma omp parallel num_threads(nt)
   {
     int t = MY_OMP_GET_THREAD_NUM();
@@ -1351,3 +3049,142 @@ void get_subgrid(BIGINT &offset1,BIGINT &offset2,BIGINT &offset3,BIGINT &size1,B
     size3 = 1;
   }
 }
+
+
+// ns = 2,...,MAX_NSPREAD specialized routine selection ----------------------
+// Per instruction set entry points: the (force-inlined) kernel code above gets
+// compiled inside each, for that ISA's target and vector length (in FLTs).
+#define SPREAD_ISA_KERNELS(ISA,TARGET,BYTES)                              \
+template<int ns, int ndims> TARGET                                        \
+static void spread_subproblem_##ISA(BIGINT *offset, BIGINT *size, FLT *du, \
+                                    BIGINT M, FLT *kx, FLT *ky, FLT *kz,  \
+                                    FLT *dd, int nvec, BIGINT *i0,        \
+                                    FLT *kv, const spread_opts *opts)     \
+{ spread_subproblem_nd<ns,ndims,BYTES/sizeof(FLT)>(offset,size,du,M,kx,ky,kz,dd,nvec,i0,kv,opts); } \
+template<int ns, int ndims> TARGET                                        \
+static void interp_chunk_##ISA(FLT *out, int n, FLT *x, FLT *y, FLT *z,  \
+                               FLT *du, BIGINT N1, BIGINT N2, BIGINT N3,  \
+                               int nvec, BIGINT *i0, FLT *kv,             \
+                               const spread_opts *opts)                   \
+{ if (opts->ghost)                                                        \
+    interp_chunk_nd<ns,ndims,BYTES/sizeof(FLT),true>(out,n,x,y,z,du,N1,N2,N3,nvec,i0,kv,opts); \
+  else                                                                    \
+    interp_chunk_nd<ns,ndims,BYTES/sizeof(FLT),false>(out,n,x,y,z,du,N1,N2,N3,nvec,i0,kv,opts); } \
+template<int ns, int ndims> TARGET                                        \
+static void spread_chunk_##ISA(FLT *du, int n, FLT *x, FLT *y, FLT *z,   \
+                               FLT *in, BIGINT N1, BIGINT N2, BIGINT N3,  \
+                               int nvec, BIGINT *i0, FLT *kv,             \
+                               const spread_opts *opts)                   \
+{ if (opts->ghost)                                                        \
+    spread_chunk_nd<ns,ndims,BYTES/sizeof(FLT),true>(du,n,x,y,z,in,N1,N2,N3,nvec,i0,kv,opts); \
+  else                                                                    \
+    spread_chunk_nd<ns,ndims,BYTES/sizeof(FLT),false>(du,n,x,y,z,in,N1,N2,N3,nvec,i0,kv,opts); }
+
+SPREAD_ISA_KERNELS(generic, , SIMD_BASE_BYTES)
+#ifdef SIMD_HAVE_AVX2
+SPREAD_ISA_KERNELS(avx2, SIMD_TARGET_AVX2, 32)
+#endif
+#ifdef SIMD_HAVE_AVX512
+SPREAD_ISA_KERNELS(avx512, SIMD_TARGET_AVX512, 64)
+#endif
+
+#define SET_SPREAD_KERNELS(ISA)                       \
+  opts.spread_subprob[0] = spread_subproblem_##ISA<ns,1>; \
+  opts.spread_subprob[1] = spread_subproblem_##ISA<ns,2>; \
+  opts.spread_subprob[2] = spread_subproblem_##ISA<ns,3>; \
+  opts.interp_chunk[0] = interp_chunk_##ISA<ns,1>;        \
+  opts.interp_chunk[1] = interp_chunk_##ISA<ns,2>;        \
+  opts.interp_chunk[2] = interp_chunk_##ISA<ns,3>;        \
+  opts.spread_chunk[0] = spread_chunk_##ISA<ns,1>;        \
+  opts.spread_chunk[1] = spread_chunk_##ISA<ns,2>;        \
+  opts.spread_chunk[2] = spread_chunk_##ISA<ns,3>;
+
+template<int ns>
+static int set_spread_kernels_ns(spread_opts &opts, int isa)
+// isa is a SIMD_* level; those no wider than the compile flags give use generic.
+// Returns the level of the kernels set
+{
+  (void)isa;                          // (unused if no ISA wider than flags)
+  opts.ker_point = ker_point<ns>;     // (setpts only, so ISA-independent)
+#ifdef SIMD_HAVE_AVX512
+  if (isa==SIMD_AVX512) {
+    SET_SPREAD_KERNELS(avx512)
+    return SIMD_AVX512;
+  }
+#endif
+#ifdef SIMD_HAVE_AVX2
+  if (isa>=SIMD_AVX2) {
+    SET_SPREAD_KERNELS(avx2)
+    return SIMD_AVX2;
+  }
+#endif
+  SET_SPREAD_KERNELS(generic)
+  return SIMD_GENERIC;
+}
+
+static int set_spread_kernels(spread_opts &opts)
+/* Sets ptrs in opts to the t1 subproblem and direct chunk spreaders and t2
+   chunk interpolators (one per dimension) specialized to kernel width
+   opts.nspread, and compiled for the widest instruction set (SSE/AVX2/AVX-512)
+   this CPU supports, as found by CPUID at runtime (capped by env var
+   FINUFFT_SIMD_MAX, see simd_level), so that a library built without
+   -march=native still gets wide SIMD. Called by setup_spreader, so the ns and
+   ISA switches are done once per plan rather than per NU pt. Needs
+   MAX_NSPREAD<=16.
+   Returns the SIMD_* level of the kernels set (SIMD_GENERIC if the compile
+   flags are at least as wide as the CPU's), or -1 if ns is out of range.
+*/
+{
+  static const int isa = simd_level();    // CPU can't change, so ask once
+  int level = -1;
+  switch (opts.nspread) {
+  case 2: level = set_spread_kernels_ns<2>(opts,isa); break;
+  case 3: level = set_spread_kernels_ns<3>(opts,isa); break;
+  case 4: level = set_spread_kernels_ns<4>(opts,isa); break;
+  case 5: level = set_spread_kernels_ns<5>(opts,isa); break;
+  case 6: level = set_spread_kernels_ns<6>(opts,isa); break;
+  case 7: level = set_spread_kernels_ns<7>(opts,isa); break;
+  case 8: level = set_spread_kernels_ns<8>(opts,isa); break;
+  case 9: level = set_spread_kernels_ns<9>(opts,isa); break;
+  case 10: level = set_spread_kernels_ns<10>(opts,isa); break;
+  case 11: level = set_spread_kernels_ns<11>(opts,isa); break;
+  case 12: level = set_spread_kernels_ns<12>(opts,isa); break;
+  case 13: level = set_spread_kernels_ns<13>(opts,isa); break;
+  case 14: level = set_spread_kernels_ns<14>(opts,isa); break;
+  case 15: level = set_spread_kernels_ns<15>(opts,isa); break;
+  case 16: level = set_spread_kernels_ns<16>(opts,isa); break;
+  default:
+    fprintf(stderr,"%s: nspread=%d not in [2,16]!\n",__func__,opts.nspread);
+    for (int d=0; d<3; ++d) {
+      opts.spread_subprob[d] = NULL;
+      opts.interp_chunk[d] = NULL;
+      opts.spread_chunk[d] = NULL;
+    }
+    opts.ker_point = NULL;
+  }
+  return level;
+}
+
+// instantiate the sort-index routines for both index types (see
+// spreadinterp.h), since they are called from finufft.cpp and perftest...
+#define INSTANTIATE_SORT_INDEX_ROUTINES(I)                                    \
+  template int indexSort(I*, BIGINT, BIGINT, BIGINT, BIGINT, FLT*, FLT*,     \
+                         FLT*, spread_opts);                                  \
+  template void fold_sorted_pts(FLT*, FLT*, FLT*, I*, BIGINT, BIGINT, BIGINT, \
+                                BIGINT, FLT*, FLT*, FLT*, spread_opts);       \
+  template int setup_spread_plan(SPREAD_PLAN**, I*, BIGINT, BIGINT, BIGINT,  \
+                                 BIGINT, FLT*, FLT*, FLT*, spread_opts, int, \
+                                 int, int);                                   \
+  template int setup_ker_cache(KER_CACHE**, I*, BIGINT, BIGINT, BIGINT,      \
+                               BIGINT, FLT*, FLT*, FLT*, spread_opts);        \
+  template int interpSorted(I*, BIGINT, BIGINT, BIGINT, FLT*, BIGINT, FLT*,  \
+                            FLT*, FLT*, FLT*, spread_opts, int, SPREAD_PLAN*, \
+                            int, int, KER_CACHE*);                            \
+  template int spreadSorted(I*, BIGINT, BIGINT, BIGINT, FLT*, BIGINT, FLT*,  \
+                            FLT*, FLT*, FLT*, spread_opts, int, SPREAD_PLAN*, \
+                            int, int, KER_CACHE*);                            \
+  template int spreadinterpSorted(I*, BIGINT, BIGINT, BIGINT, FLT*, BIGINT,  \
+                                  FLT*, FLT*, FLT*, FLT*, spread_opts, int,  \
+                                  SPREAD_PLAN*, int, int, KER_CACHE*);
+INSTANTIATE_SORT_INDEX_ROUTINES(BIGINT)
+INSTANTIATE_SORT_INDEX_ROUTINES(uint32_t)
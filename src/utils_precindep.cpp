@@ -7,6 +7,16 @@
 #include "utils_precindep.h"
 #include "dataTypes.h"
 #include "defs.h"
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#endif
 
 
 BIGINT next235even(BIGINT n)
@@ -71,6 +81,122 @@ int get_num_threads_parallel_block()
 }
 
 
+// -------------------------- aligned allocation ----------------------------
+void* alloc_aligned(size_t nbytes, size_t align)
+// Returns ptr to nbytes of uninitialized memory whose address is a multiple of
+// align, or NULL on failure. Must be freed with free_aligned.
+{
+  if (nbytes==0) nbytes = align;     // so NULL always means failure
+#ifdef _WIN32
+  return _aligned_malloc(nbytes, align);
+#else
+  void* ptr = NULL;
+  if (posix_memalign(&ptr, align, nbytes))
+    return NULL;
+  return ptr;
+#endif
+}
+
+void free_aligned(void* ptr)
+// Frees memory from alloc_aligned. NULL is allowed, as for free().
+{
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+
+// ----------------------- NUMA page placement ------------------------------
+int numa_interleave(void* ptr, size_t nbytes)
+/* Asks the OS to interleave the (not yet touched) pages of the nbytes at ptr
+   round-robin over all online NUMA nodes, as numactl --interleave does, via
+   the mbind syscall, so that no libnuma is needed. Pages only partly in the
+   range are left alone. Returns the # nodes interleaved over, or 0 if nothing
+   was done (one node, not Linux, or the call failed), which is harmless.
+*/
+{
+#if defined(__linux__) && defined(SYS_mbind)
+  const int MAXNODES = 1024;
+  unsigned long mask[MAXNODES/(8*sizeof(unsigned long))] = {0};
+  FILE *f = fopen("/sys/devices/system/node/online","r");  // eg "0-1,3"
+  if (!f) return 0;
+  int nnodes = 0, maxnode = -1, a, b;
+  char sep;
+  while (fscanf(f,"%d",&a)==1) {
+    sep = 0;
+    b = a;
+    if (fscanf(f,"%c",&sep)==1 && sep=='-')
+      if (fscanf(f,"%d%c",&b,&sep)<1) break;
+    for (int n=a; n<=b && n<MAXNODES; ++n) {
+      mask[n/(8*sizeof(unsigned long))] |= 1UL << (n%(8*sizeof(unsigned long)));
+      ++nnodes;
+      maxnode = n;
+    }
+    if (sep!=',') break;
+  }
+  fclose(f);
+  if (nnodes<2) return 0;
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t p0 = ((size_t)ptr + page-1) / page * page;       // 1st whole page
+  size_t p1 = ((size_t)ptr + nbytes) / page * page;       // end of last one
+  if (p1<=p0) return 0;
+  const int MPOL_INTERLEAVE_ = 3;     // (from linux/mempolicy.h)
+  if (syscall(SYS_mbind, (void*)p0, p1-p0, MPOL_INTERLEAVE_, mask,
+              (unsigned long)maxnode+2, 0))
+    return 0;
+  return nnodes;
+#else
+  return 0;
+#endif
+}
+
+int advise_hugepages(void* ptr, size_t nbytes)
+/* Asks the OS to back the (preferably not yet touched) nbytes at ptr with
+   transparent huge pages (2MB on x86_64), via madvise(MADV_HUGEPAGE), cutting
+   TLB misses for random access to big arrays. Only the whole 2MB-aligned huge
+   pages inside the range are advised, so that any allocator's memory may be
+   used (the <=4MB of edges stay small pages). Returns the # huge pages
+   advised, or 0 if none (too small, not Linux, or THP not in the kernel).
+*/
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  const size_t HUGE = (size_t)1<<21;
+  size_t p0 = ((size_t)ptr + HUGE-1) / HUGE * HUGE;       // 1st whole page
+  size_t p1 = ((size_t)ptr + nbytes) / HUGE * HUGE;       // end of last one
+  if (p1<=p0 || madvise((void*)p0, p1-p0, MADV_HUGEPAGE))
+    return 0;
+  return (int)((p1-p0)/HUGE);
+#else
+  return 0;
+#endif
+}
+
+static size_t detect_cache_bytes(int level)
+// helper for cache_bytes: asks the OS, returning 0 if it cannot tell
+{
+  long b = 0;
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+  b = sysconf(level==1 ? _SC_LEVEL1_DCACHE_SIZE : _SC_LEVEL2_CACHE_SIZE);
+#endif
+  return (b>0) ? (size_t)b : 0;
+}
+
+size_t cache_bytes(int level)
+/* Returns the size in bytes of the level 1 data, or level 2, cache of a core,
+   as reported by the OS (glibc's sysconf), or if that fails (not Linux, or
+   some VMs report 0) a typical size: 32KB for L1, 1MB for L2. Detected once.
+   Used by the spreader to size its sort bins.
+*/
+{
+  static const size_t L1 = detect_cache_bytes(1), L2 = detect_cache_bytes(2);
+  if (level==1)
+    return L1 ? L1 : ((size_t)1<<15);
+  return L2 ? L2 : ((size_t)1<<20);
+}
+
+
 // ---------- thread-safe rand number generator for Windows platform ---------
 // (note this is used by macros in defs.h, and supplied in linux/macosx)
 #ifdef _WIN32
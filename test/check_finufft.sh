@@ -69,30 +69,193 @@ T=finufft1dmany_test$PRECSUF
 E=${PIPESTATUS[0]}
 if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
 
+((N++))
+T=finufft1dmany_test$PRECSUF
+# same in 5 batches of 1, pipelined (batch_pipeline=1; needs >1 thread)
+./$T$FEX 5 1e2 1e3 $FINUFFT_REQ_TOL 0 0 1 2 0.0 $CHECK_TOL batch_pipeline=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
 ((N++))
 T=finufft2d_test$PRECSUF
 ./$T$FEX 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL 2>$DIR/$T.err.out | tee $DIR/$T.out
 E=${PIPESTATUS[0]}
 if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
 
+((N++))
+T=finufft2d_test$PRECSUF
+# same with owner-computes tiled spreading (spread_method=2)
+./$T$FEX 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL spread_method=2 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft2d_test$PRECSUF
+# same with direct single-thread spreading (spread_method=3)
+./$T$FEX 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL spread_method=3 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft2d_test$PRECSUF
+# same with bin-balanced subproblems (spread_method=1, spread_balance=1)
+./$T$FEX 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL spread_method=1 spread_balance=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
 ((N++))
 T=finufft2dmany_test$PRECSUF
 ./$T$FEX 3 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 0 0 2 0.0 $CHECK_TOL 2>$DIR/$T.err.out | tee $DIR/$T.out
 E=${PIPESTATUS[0]}
 if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
 
+((N++))
+T=finufft2dmany_test$PRECSUF
+# same with fused batch spreading (spread_thread=3)
+./$T$FEX 3 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 3 0 2 0.0 $CHECK_TOL 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft2dmany_test$PRECSUF
+# same with ghost pts padding the fine grids (spread_ghost=1)
+./$T$FEX 3 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 3 0 2 0.0 $CHECK_TOL spread_ghost=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft2dmany_test$PRECSUF
+# same with t2 fine grids zero-padded once at plan (zeropad_once=1)
+./$T$FEX 3 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 0 0 2 0.0 $CHECK_TOL zeropad_once=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft2dmany_test$PRECSUF
+# same with pruned FFT passes (fftw_prune=1), with ghost pts
+./$T$FEX 3 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 0 0 2 0.0 $CHECK_TOL spread_ghost=1 fftw_prune=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft2dmany_test$PRECSUF
+# same in batches of 2,2,1 (exact-size FFT plans for the short last batch)
+./$T$FEX 5 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 0 2 2 0.0 $CHECK_TOL spread_ghost=1 fftw_prune=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft2dmany_test$PRECSUF
+# same with FFTW plans and kernel series shared via the cache (plan_cache=1)
+./$T$FEX 5 1e2 1e1 1e3 $FINUFFT_REQ_TOL 0 0 2 2 0.0 $CHECK_TOL spread_ghost=1 fftw_prune=1 plan_cache=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
 ((N++))
 T=finufft3d_test$PRECSUF
 ./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL 2>$DIR/$T.err.out | tee $DIR/$T.out
 E=${PIPESTATUS[0]}
 if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
 
+((N++))
+T=finufft3d_test$PRECSUF
+# same with owner-computes tiled spreading (spread_method=2)
+./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL spread_method=2 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# same with precomputed kernel values (spread_kercache=1)
+./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL spread_method=1 spread_kercache=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# same with plan's folded sorted copy of NU pts (spread_copypts=1)
+./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL spread_method=1 spread_copypts=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# same with ghost pts padding the fine grid (spread_ghost=1)
+./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL spread_method=1 spread_ghost=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# same with slab-local NUMA placement and scheduling (numa=2)
+./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL spread_method=1 numa=2 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# with transparent huge pages asked for (hugepages=1); fine grids big enough
+# (>4MB) to hold whole 2MB pages
+./$T$FEX 40 40 40 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL hugepages=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# same, sorted, with t2 interp from cache-sized subgrid copies (spread_interp_method=1)
+./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 1 0.0 $CHECK_TOL spread_method=1 spread_interp_method=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# same, sorted into Hilbert-curve bin order (spread_binorder=2), both methods
+./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 1 0.0 $CHECK_TOL spread_method=1 spread_balance=1 spread_interp_method=1 spread_binorder=2 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# same with the generic spread/interp kernels even on an AVX2/AVX-512 CPU
+# (FINUFFT_SIMD_MAX=0; no effect with -march=native, which builds one set)
+FINUFFT_SIMD_MAX=0 ./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# same with at most the AVX2 kernels (FINUFFT_SIMD_MAX=1)
+FINUFFT_SIMD_MAX=1 ./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3d_test$PRECSUF
+# same with at most the AVX-512 kernels (FINUFFT_SIMD_MAX=2, ie no cap)
+FINUFFT_SIMD_MAX=2 ./$T$FEX 5 10 20 1e2 $FINUFFT_REQ_TOL 0 2 0.0 $CHECK_TOL 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
 ((N++))
 T=finufft3dmany_test$PRECSUF
 ./$T$FEX 2 10 50 20 1e2 $FINUFFT_REQ_TOL 0 0 0 2 0.0 $CHECK_TOL 2>$DIR/$T.err.out | tee $DIR/$T.out
 E=${PIPESTATUS[0]}
 if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
 
+((N++))
+T=finufft3dmany_test$PRECSUF
+# same with pruned FFT passes (fftw_prune=1); odd and even mode counts
+./$T$FEX 2 11 50 21 1e2 $FINUFFT_REQ_TOL 0 0 0 2 0.0 $CHECK_TOL fftw_prune=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
+((N++))
+T=finufft3dmany_test$PRECSUF
+# same in 3 batches of 2, pipelined (batch_pipeline=1), with ghost pts
+./$T$FEX 5 11 50 21 1e2 $FINUFFT_REQ_TOL 0 0 2 2 0.0 $CHECK_TOL spread_ghost=1 fftw_prune=1 batch_pipeline=1 2>$DIR/$T.err.out | tee $DIR/$T.out
+E=${PIPESTATUS[0]}
+if [[ $E -eq 0 ]]; then echo passed; elif [[ $E -eq $SIGSEGV ]]; then echo crashed; ((CRASHES++)); else echo failed; ((FAILS++)); fi
+
 ((N++))
 T=dumbinputs$PRECSUF
 ./$T$FEX 2>$DIR/$T.err.out | tee $DIR/$T.out
@@ -15,6 +15,7 @@ int main(int argc, char* argv[])
    guru: makeplan followed by immediate destroy. Barnett 5/26/20.
    Either precision with dual-prec lib funcs 7/3/20.
    Added a chkbnds case to 1d1, 4/9/21.
+   guru sortperm and spread_sortedio checks at the end.
 
    Compile with (better to go up a directory and use: make test/dumbinputs) :
    g++ -std=c++14 -fopenmp dumbinputs.cpp -I../include ../lib/libfinufft.so -o dumbinputs  -lfftw3 -lfftw3_omp -lm
@@ -332,6 +333,41 @@ int main(int argc, char* argv[])
   FINUFFT_DESTROY(plan);
   FINUFFT_MAKEPLAN(3, 1, Ns, +1, 1, acc, &plan, NULL);  // type 3, now kill it
   FINUFFT_DESTROY(plan);
+
+  // guru sorted-order I/O: c permuted by sortperm must give same t1 as usual
+  x = (FLT *)malloc(sizeof(FLT)*M);
+  c = (CPX*)malloc(sizeof(CPX)*M);
+  CPX* cs = (CPX*)malloc(sizeof(CPX)*M);
+  F = (CPX*)malloc(sizeof(CPX)*N);
+  BIGINT* perm = (BIGINT*)malloc(sizeof(BIGINT)*M);
+  for (int j=0; j<M; ++j) {
+    x[j] = PI*cos((FLT)j);
+    c[j] = sin((FLT)1.3*j) + IMA*cos((FLT)0.9*j);
+  }
+  Ns[0] = N;
+  FINUFFT_MAKEPLAN(1, 1, Ns, +1, 1, acc, &plan, NULL);
+  ier = FINUFFT_SORTPERM(plan, perm);
+  printf("guru sortperm before setpts:	ier=%d (should complain)\n",ier);
+  FINUFFT_SETPTS(plan, M, x, NULL, NULL, 0, NULL, NULL, NULL);
+  FINUFFT_EXECUTE(plan, c, Fe);
+  FINUFFT_DESTROY(plan);
+  opts.spread_sort = 1;               // (so perm is not the identity)
+  opts.spread_sortedio = 1;
+  FINUFFT_MAKEPLAN(1, 1, Ns, +1, 1, acc, &plan, &opts);
+  FINUFFT_SETPTS(plan, M, x, NULL, NULL, 0, NULL, NULL, NULL);
+  ier = FINUFFT_SORTPERM(plan, perm);
+  for (int j=0; j<M; ++j) cs[j] = c[perm[j]];
+  FINUFFT_EXECUTE(plan, cs, F);
+  FINUFFT_DESTROY(plan);
+  for (int k=0; k<N; ++k) F[k] -= Fe[k];
+  printf("guru 1d1 spread_sortedio=1:\tier=%d\trel diff %s\n",ier,
+         twonorm(N,F) <= 10*EPSILON*twonorm(N,Fe) ? "small" : "LARGE");
+  FINUFFT_MAKEPLAN(3, 1, Ns, +1, 1, acc, &plan, NULL);
+  FINUFFT_SETPTS(plan, M, x, NULL, NULL, N, x, NULL, NULL);
+  ier = FINUFFT_SORTPERM(plan, perm);
+  printf("guru sortperm type 3:\tier=%d (should complain)\n",ier);
+  FINUFFT_DESTROY(plan);
+  free(x); free(c); free(cs); free(F); free(Fe); free(perm);
   // *** todo: more extensive bad inputs and error catching in guru...
   
   return 0;
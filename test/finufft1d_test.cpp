@@ -6,9 +6,11 @@ using namespace std;
 const char* help[]={
   "Tester for FINUFFT in 1d, all 3 types, either precision.",
   "",
-  "Usage: finufft1d_test Nmodes Nsrc [tol [debug [spread_sort [upsampfac [errfail]]]]]",
+  "Usage: finufft1d_test Nmodes Nsrc [tol [debug [spread_sort [upsampfac [errfail]]]]] [name=value ...]",
   "\teg:\tfinufft1d_test 1e6 1e6 1e-6 1 2 2.0 1e-5",
   "\tnotes:\tif errfail present, exit code 1 if any error > errfail",
+  "\t\tname=value args (after the others) set that nufft_opts field, eg",
+  "\t\tspread_method=2 spread_ghost=1 (any int field, or upsampfac)",
   NULL};
 // Barnett 1/22/17 onwards
 
@@ -20,19 +22,22 @@ int main(int argc, char* argv[])
   nufft_opts opts; FINUFFT_DEFAULT_OPTS(&opts);  // put defaults in opts
   // opts.fftw = FFTW_MEASURE;  // change from usual FFTW_ESTIMATE
   int isign = +1;            // choose which exponential sign to test
-  if (argc<3 || argc>8) {
+  int nargs = count_positional_args(argc,argv);   // then name=value ones
+  if (nargs<3 || nargs>8) {
     for (int i=0; help[i]; ++i)
       fprintf(stderr,"%s\n",help[i]);
     return 2;
   }
   sscanf(argv[1],"%lf",&w); N = (BIGINT)w;
   sscanf(argv[2],"%lf",&w); M = (BIGINT)w;
-  if (argc>3) sscanf(argv[3],"%lf",&tol);
-  if (argc>4) sscanf(argv[4],"%d",&opts.debug);
+  if (nargs>3) sscanf(argv[3],"%lf",&tol);
+  if (nargs>4) sscanf(argv[4],"%d",&opts.debug);
   opts.spread_debug = (opts.debug>1) ? 1 : 0;  // see output from spreader
-  if (argc>5) sscanf(argv[5],"%d",&opts.spread_sort);
-  if (argc>6) { sscanf(argv[6],"%lf",&w); opts.upsampfac=(FLT)w; }
-  if (argc>7) sscanf(argv[7],"%lf",&errfail);
+  if (nargs>5) sscanf(argv[5],"%d",&opts.spread_sort);
+  if (nargs>6) { sscanf(argv[6],"%lf",&w); opts.upsampfac=(FLT)w; }
+  if (nargs>7) sscanf(argv[7],"%lf",&errfail);
+  if (set_opts_from_args(nargs,argc,argv,&opts))
+    return 2;
   
   cout << scientific << setprecision(15);
 
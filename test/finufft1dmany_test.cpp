@@ -6,9 +6,11 @@ using namespace std;
 const char* help[]={
   "Tester for FINUFFT in 1d, vectorized, all 3 types, either precision.",
   "",
-  "Usage: finufft1dmany_test ntrans Nmodes Nsrc [tol [debug [spread_thread [maxbatchsize [spreadsort [upsampfac [errfail]]]]]]]",
+  "Usage: finufft1dmany_test ntrans Nmodes Nsrc [tol [debug [spread_thread [maxbatchsize [spreadsort [upsampfac [errfail]]]]]]] [name=value ...]",
   "\teg:\tfinufft1dmany_test 100 1e3 1e4 1e-6 1 0 0 2 0.0 1e-5",
   "\tnotes:\tif errfail present, exit code 1 if any error > errfail",
+  "\t\tname=value args (after the others) set that nufft_opts field, eg",
+  "\t\tspread_method=2 spread_ghost=1 (any int field, or upsampfac)",
   NULL};
 // Malleo 2019 based on Shih 2018. Tidied, extra args, Barnett 5/25/20 onwards
 
@@ -21,7 +23,8 @@ int main(int argc, char* argv[])
   nufft_opts opts; FINUFFT_DEFAULT_OPTS(&opts);
   // opts.fftw = FFTW_MEASURE;  // change from usual FFTW_ESTIMATE
   int isign = +1;             // choose which exponential sign to test
-  if (argc<4 || argc>11) {
+  int nargs = count_positional_args(argc,argv);   // then name=value ones
+  if (nargs<4 || nargs>11) {
     for (int i=0; help[i]; ++i)
       fprintf(stderr,"%s\n",help[i]);
     return 2;
@@ -29,14 +32,16 @@ int main(int argc, char* argv[])
   sscanf(argv[1],"%lf",&w); ntransf = (int)w;
   sscanf(argv[2],"%lf",&w); N = (BIGINT)w;
   sscanf(argv[3],"%lf",&w); M = (BIGINT)w;
-  if (argc>4) sscanf(argv[4],"%lf",&tol);
-  if (argc>5) sscanf(argv[5],"%d",&opts.debug);
+  if (nargs>4) sscanf(argv[4],"%lf",&tol);
+  if (nargs>5) sscanf(argv[5],"%d",&opts.debug);
   opts.spread_debug = (opts.debug>1) ? 1 : 0;  // see output from spreader
-  if (argc>6) sscanf(argv[6],"%d",&opts.spread_thread);  
-  if (argc>7) sscanf(argv[7],"%d",&opts.maxbatchsize);    
-  if (argc>8) sscanf(argv[8],"%d",&opts.spread_sort);
-  if (argc>9) { sscanf(argv[9],"%lf",&w); opts.upsampfac=(FLT)w; }
-  if (argc>10) sscanf(argv[10],"%lf",&errfail);
+  if (nargs>6) sscanf(argv[6],"%d",&opts.spread_thread);  
+  if (nargs>7) sscanf(argv[7],"%d",&opts.maxbatchsize);    
+  if (nargs>8) sscanf(argv[8],"%d",&opts.spread_sort);
+  if (nargs>9) { sscanf(argv[9],"%lf",&w); opts.upsampfac=(FLT)w; }
+  if (nargs>10) sscanf(argv[10],"%lf",&errfail);
+  if (set_opts_from_args(nargs,argc,argv,&opts))
+    return 2;
 
   cout << scientific << setprecision(15);
  
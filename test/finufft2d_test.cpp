@@ -6,9 +6,11 @@ using namespace std;
 const char* help[]={
   "Tester for FINUFFT in 2d, all 3 types, either precision.",
   "",
-  "Usage: finufft2d_test Nmodes1 Nmodes2 Nsrc [tol [debug [spread_sort [upsampfac [errfail]]]]]",
+  "Usage: finufft2d_test Nmodes1 Nmodes2 Nsrc [tol [debug [spread_sort [upsampfac [errfail]]]]] [name=value ...]",
   "\teg:\tfinufft2d_test 1000 1000 1000000 1e-12 1 2 2.0 1e-11",
   "\tnotes:\tif errfail present, exit code 1 if any error > errfail",
+  "\t\tname=value args (after the others) set that nufft_opts field, eg",
+  "\t\tspread_method=2 spread_ghost=1 (any int field, or upsampfac)",
   NULL};
 // Barnett 2/1/17 onwards
 
@@ -20,7 +22,8 @@ int main(int argc, char* argv[])
   nufft_opts opts; FINUFFT_DEFAULT_OPTS(&opts);
   // opts.fftw = FFTW_MEASURE;  // change from usual FFTW_ESTIMATE
   int isign = +1;             // choose which exponential sign to test
-  if (argc<4 || argc>9) {
+  int nargs = count_positional_args(argc,argv);   // then name=value ones
+  if (nargs<4 || nargs>9) {
     for (int i=0; help[i]; ++i)
       fprintf(stderr,"%s\n",help[i]);
     return 2;
@@ -28,12 +31,14 @@ int main(int argc, char* argv[])
   sscanf(argv[1],"%lf",&w); N1 = (BIGINT)w;
   sscanf(argv[2],"%lf",&w); N2 = (BIGINT)w;
   sscanf(argv[3],"%lf",&w); M = (BIGINT)w;
-  if (argc>4) sscanf(argv[4],"%lf",&tol);
-  if (argc>5) sscanf(argv[5],"%d",&opts.debug);
+  if (nargs>4) sscanf(argv[4],"%lf",&tol);
+  if (nargs>5) sscanf(argv[5],"%d",&opts.debug);
   opts.spread_debug = (opts.debug>1) ? 1 : 0;  // see output from spreader
-  if (argc>6) sscanf(argv[6],"%d",&opts.spread_sort);
-  if (argc>7) { sscanf(argv[7],"%lf",&w); opts.upsampfac=(FLT)w; }
-  if (argc>8) sscanf(argv[8],"%lf",&errfail);
+  if (nargs>6) sscanf(argv[6],"%d",&opts.spread_sort);
+  if (nargs>7) { sscanf(argv[7],"%lf",&w); opts.upsampfac=(FLT)w; }
+  if (nargs>8) sscanf(argv[8],"%lf",&errfail);
+  if (set_opts_from_args(nargs,argc,argv,&opts))
+    return 2;
   
   cout << scientific << setprecision(15);
   BIGINT N = N1*N2;
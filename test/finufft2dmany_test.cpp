@@ -6,9 +6,11 @@ using namespace std;
 const char* help[]={
   "Tester for FINUFFT in 2d, vectorized, all 3 types, either precision.",
   "",
-  "Usage: finufft2dmany_test ntrans Nmodes1 Nmodes2 Nsrc [tol [debug [spread_thread [maxbatchsize [spreadsort [upsampfac [errfail]]]]]]]",
+  "Usage: finufft2dmany_test ntrans Nmodes1 Nmodes2 Nsrc [tol [debug [spread_thread [maxbatchsize [spreadsort [upsampfac [errfail]]]]]]] [name=value ...]",
   "\teg:\tfinufft2dmany_test 100 1e2 1e2 1e5 1e-6 1 0 0 2 0.0 1e-5",
   "\tnotes:\tif errfail present, exit code 1 if any error > errfail",
+  "\t\tname=value args (after the others) set that nufft_opts field, eg",
+  "\t\tspread_method=2 spread_ghost=1 (any int field, or upsampfac)",
   NULL};
 // Melody Shih Jun 2018; Barnett removed many_seq 7/27/18. Extra args 5/21/20.
 
@@ -21,7 +23,8 @@ int main(int argc, char* argv[])
   nufft_opts opts; FINUFFT_DEFAULT_OPTS(&opts);
   //opts.fftw = FFTW_MEASURE;  // change from default FFTW_ESTIMATE
   int isign = +1;                // choose which exponential sign to test
-  if (argc<5 || argc>12) {
+  int nargs = count_positional_args(argc,argv);   // then name=value ones
+  if (nargs<5 || nargs>12) {
     for (int i=0; help[i]; ++i)
       fprintf(stderr,"%s\n",help[i]);
     return 2;
@@ -30,14 +33,16 @@ int main(int argc, char* argv[])
   sscanf(argv[2],"%lf",&w); N1 = (BIGINT)w;
   sscanf(argv[3],"%lf",&w); N2 = (BIGINT)w;
   sscanf(argv[4],"%lf",&w); M = (BIGINT)w;
-  if (argc>5) sscanf(argv[5],"%lf",&tol);
-  if (argc>6) sscanf(argv[6],"%d",&opts.debug);
+  if (nargs>5) sscanf(argv[5],"%lf",&tol);
+  if (nargs>6) sscanf(argv[6],"%d",&opts.debug);
   opts.spread_debug = (opts.debug>1) ? 1 : 0;  // see output from spreader
-  if (argc>7) sscanf(argv[7],"%d",&opts.spread_thread);  
-  if (argc>8) sscanf(argv[8],"%d",&opts.maxbatchsize);  
-  if (argc>9) sscanf(argv[9],"%d",&opts.spread_sort);
-  if (argc>10) { sscanf(argv[10],"%lf",&w); opts.upsampfac=(FLT)w; }
-  if (argc>11) sscanf(argv[11],"%lf",&errfail);
+  if (nargs>7) sscanf(argv[7],"%d",&opts.spread_thread);  
+  if (nargs>8) sscanf(argv[8],"%d",&opts.maxbatchsize);  
+  if (nargs>9) sscanf(argv[9],"%d",&opts.spread_sort);
+  if (nargs>10) { sscanf(argv[10],"%lf",&w); opts.upsampfac=(FLT)w; }
+  if (nargs>11) sscanf(argv[11],"%lf",&errfail);
+  if (set_opts_from_args(nargs,argc,argv,&opts))
+    return 2;
   
   cout << scientific << setprecision(15);
   BIGINT N = N1*N2;
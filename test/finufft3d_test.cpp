@@ -6,9 +6,11 @@ using namespace std;
 const char* help[]={
   "Tester for FINUFFT in 3d, all 3 types, either precision.",
   "",
-  "Usage: finufft3d_test Nmodes1 Nmodes2 Nmodes3 Nsrc [tol [debug [spread_sort [upsampfac [errfail]]]]]",
+  "Usage: finufft3d_test Nmodes1 Nmodes2 Nmodes3 Nsrc [tol [debug [spread_sort [upsampfac [errfail]]]]] [name=value ...]",
   "\teg:\tfinufft3d_test 100 200 50 1e6 1e-12 0 2 0.0 1e-11",
   "\tnotes:\tif errfail present, exit code 1 if any error > errfail",
+  "\t\tname=value args (after the others) set that nufft_opts field, eg",
+  "\t\tspread_method=2 spread_ghost=1 (any int field, or upsampfac)",
   NULL};
 // Barnett 2/2/17 onwards.
 
@@ -22,7 +24,8 @@ int main(int argc, char* argv[])
   //opts.spread_max_sp_size = 3e4; // override test
   //opts.spread_nthr_atomic = 15;  // "
   int isign = +1;             // choose which exponential sign to test
-  if (argc<5 || argc>10) {
+  int nargs = count_positional_args(argc,argv);   // then name=value ones
+  if (nargs<5 || nargs>10) {
     for (int i=0; help[i]; ++i)
       fprintf(stderr,"%s\n",help[i]);
     return 2;
@@ -31,12 +34,14 @@ int main(int argc, char* argv[])
   sscanf(argv[2],"%lf",&w); N2 = (BIGINT)w;
   sscanf(argv[3],"%lf",&w); N3 = (BIGINT)w;
   sscanf(argv[4],"%lf",&w); M = (BIGINT)w;
-  if (argc>5) sscanf(argv[5],"%lf",&tol);
-  if (argc>6) sscanf(argv[6],"%d",&opts.debug);  // can be 0,1 or 2
+  if (nargs>5) sscanf(argv[5],"%lf",&tol);
+  if (nargs>6) sscanf(argv[6],"%d",&opts.debug);  // can be 0,1 or 2
   opts.spread_debug = (opts.debug>1) ? 1 : 0;  // see output from spreader
-  if (argc>7) sscanf(argv[7],"%d",&opts.spread_sort);
-  if (argc>8) { sscanf(argv[8],"%lf",&w); opts.upsampfac=(FLT)w; }
-  if (argc>9) sscanf(argv[9],"%lf",&errfail);
+  if (nargs>7) sscanf(argv[7],"%d",&opts.spread_sort);
+  if (nargs>8) { sscanf(argv[8],"%lf",&w); opts.upsampfac=(FLT)w; }
+  if (nargs>9) sscanf(argv[9],"%lf",&errfail);
+  if (set_opts_from_args(nargs,argc,argv,&opts))
+    return 2;
   
   cout << scientific << setprecision(15);
   BIGINT N = N1*N2*N3;